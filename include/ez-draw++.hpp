@@ -760,6 +760,12 @@ public:
  /// \param x,y Les coordonnées du pixel voulu dans l'image.
  /// \return Une instance de la classe EZPixel qui permet de consulter ou modifier les valeurs de composantes de couleur du pixel.
  EZPixel getPixel(int x,int y);
+ /// Accesseur direct au tableau des pixels de l'image, rangés ligne par ligne avec quatre octets (rouge, vert, bleu, alpha) par pixel.
+ /// Le pixel de coordonnées x,y se trouve à l'indice (y*getWidth()+x)*4. Remplir l'image par ce tableau est bien plus rapide qu'avec getPixel(), et plusieurs threads peuvent y écrire en même temps tant qu'ils travaillent sur des pixels différents.
+ /// \return Un pointeur sur le premier octet du pixel de coordonnées 0,0.
+ EZuint8 *getPixels();
+ /// Version constante de EZuint8 *EZImage::getPixels().
+ const EZuint8 *getPixels() const;
  /// Affiche l'image dans la fenêtre.
  /// Si has_alpha est vrai, applique la transparence, c’est-à-dire n’affiche que les pixels opaques.
  /// \param win la fenêtre où aura lieu le tracé.
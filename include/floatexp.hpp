@@ -0,0 +1,94 @@
+#ifndef FLOATEXP_HPP
+#define FLOATEXP_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// A double mantissa with an exponent of its own: the value is mantissa * 2^exponent. It has the
+// precision of a double without its range, for the sizes of pixels and the offsets of the
+// perturbation past 1e-308, where doubles underflow. Every operation normalizes its result, so the
+// iterations of the perturbation do not use it: they scale their doubles by an exponent instead.
+// The mantissa is kept in [1, 2) by reading and rewriting the exponent bits of the double, which is
+// cheaper than frexp and ldexp. Zero has a zero mantissa and an exponent below any other.
+class FloatExp {
+    public:
+        static const int ZERO_EXPONENT = -(1 << 28);
+
+    private:
+        double mantissa;
+        int exponent;
+
+        // 2^k for -1022 <= k <= 1023, as a normal double.
+        static inline double power_of_two(int k) {
+            const uint64_t bits = uint64_t(k + 1023) << 52;
+            double value;
+            std::memcpy(&value, &bits, sizeof value);
+            return value;
+        }
+
+        // mantissa * 2^exponent with the mantissa brought back to [1, 2).
+        static inline FloatExp normalized(double mantissa, int exponent) {
+            uint64_t bits;
+            std::memcpy(&bits, &mantissa, sizeof bits);
+            const int biased = int(bits >> 52 & 0x7ff);
+            FloatExp r;
+            if (biased == 0) { // Zero, or a subnormal, which only comes from a double given as such
+                if (mantissa == 0) return r;
+                int shift;
+                r.mantissa = 2 * std::frexp(mantissa, &shift);
+                r.exponent = exponent + shift - 1;
+                return r;
+            }
+            bits = (bits & ~(uint64_t(0x7ff) << 52)) | uint64_t(1023) << 52;
+            std::memcpy(&r.mantissa, &bits, sizeof bits);
+            r.exponent = exponent + biased - 1023;
+            return r;
+        }
+
+    public:
+        FloatExp() : mantissa(0), exponent(ZERO_EXPONENT) {}
+        FloatExp(double value) : FloatExp(normalized(value, 0)) {}
+        FloatExp(double _mantissa, int _exponent) : FloatExp(normalized(_mantissa, _exponent)) {}
+
+        inline double get_mantissa() const { return mantissa; }
+        inline int get_exponent() const { return exponent; }
+        // log2 |value|, -infinity for zero.
+        inline double log2() const { return mantissa == 0 ? -INFINITY : exponent + std::log2(std::fabs(mantissa)); }
+
+        explicit inline operator double() const {
+            if (exponent >= -1022 && exponent <= 1023) return mantissa * power_of_two(exponent);
+            if (exponent < -1100) return 0.;
+            return std::ldexp(mantissa, exponent); // Subnormal or infinite
+        }
+
+        inline FloatExp operator-() const {
+            FloatExp r = *this;
+            r.mantissa = -mantissa;
+            return r;
+        }
+
+        // The smaller operand is scaled to the exponent of the larger one, unless it is too small
+        // to change its mantissa.
+        friend inline FloatExp operator+(const FloatExp& a, const FloatExp& b) {
+            if (a.exponent < b.exponent) return b + a;
+            const int shift = b.exponent - a.exponent;
+            if (shift < -64) return a;
+            return normalized(a.mantissa + b.mantissa * power_of_two(shift), a.exponent);
+        }
+        friend inline FloatExp operator-(const FloatExp& a, const FloatExp& b) { return a + -b; }
+        friend inline FloatExp operator*(const FloatExp& a, const FloatExp& b) {
+            return normalized(a.mantissa * b.mantissa, a.exponent + b.exponent);
+        }
+        friend inline FloatExp operator/(const FloatExp& a, const FloatExp& b) {
+            return normalized(a.mantissa / b.mantissa, a.exponent - b.exponent);
+        }
+
+        friend inline bool operator==(const FloatExp& a, const FloatExp& b) {
+            return a.mantissa == b.mantissa && a.exponent == b.exponent;
+        }
+        friend inline bool operator!=(const FloatExp& a, const FloatExp& b) { return !(a == b); }
+        friend inline bool operator<(const FloatExp& a, const FloatExp& b) { return (b - a).mantissa > 0; }
+};
+
+#endif
@@ -2,27 +2,133 @@
 #define FRACTALES_HPP
 
 #include "ez-draw++.hpp"
+#include "render_pool.hpp"
+#include "kernels.hpp"
+#include "renderer.hpp"
+#include "perturbation.hpp"
+#include "palette.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How the images are computed, chosen from the command line.
+struct RenderSettings {
+    unsigned threads = 0; // 0 means one worker thread per core
+    KernelType kernel = detect_kernel();
+    double period_tolerance = 1e-12; // 0 disables the detection of periodic orbits
+    RenderMode mode = RenderMode::Brute;
+    GuessSettings guess; // For the solid guessing
+    double antialias = 0; // The iterations the anti-aliasing may add, as a fraction of those of the image, 0 disables it
+    Arithmetic arithmetic = Arithmetic::Auto;
+    Palette palette = Palette::Bands;
+    bool verify = false; // Compares every image with the one computed pixel by pixel
+};
 
 class Fractale : public EZWindow {
     private:
         int power, max_iterations;
-        double xmin,xmax,ymin,ymax; // Les valeurs minimum et maximum de la fenetre de visibilite.
+        // The visible part of the plane: its corner, in high precision for the deep zooms, and its size.
+        Precise xmin, ymin;
+        FloatExp xrange, yrange;
+        int pixel_step; // The distance between the samples of the first, coarse pass of an image (a power of 2)
+        RenderSettings settings;
+        RenderPool pool; // The worker threads computing the tiles of the image
+
+        // The last image received from the render thread, kept off-screen so an Expose only has to
+        // copy it to the window.
+        std::unique_ptr<EZImage> frame;
+        std::unique_ptr<EZPixmap> frame_pixmap;
+        bool frame_dirty; // Set when the power, the iterations or the viewport changed since the last computation
+
+        // The images are computed by a render thread, in passes of decreasing pixel step so that a
+        // coarse preview shows up at once while the event loop keeps running. After each pass, the
+        // thread leaves the counts in ready_counts, where timerNotify() picks them up.
+        std::thread render_thread;
+        std::atomic<bool> cancel; // Asks the render thread to drop the image it is computing
+        std::atomic<bool> rendering; // Cleared once the last pass is in ready_counts
+        std::vector<int> counts; // Only used by the render thread while it runs
+        // The fractions of an iteration of counts, for the smooth colouring. Empty with the
+        // arithmetics whose kernels do not give them.
+        std::vector<float> smooth;
+        // The last z of the pixels of counts, and what their image was, so that a higher
+        // max_iterations on the same view only goes on with the pixels that reached the previous
+        // one, and a move of the view only computes the pixels it uncovers. Written by the render
+        // thread, read by start_render() once it has stopped.
+        FinalOrbits orbits;
+        struct {
+            Precise xmin, ymin;
+            FloatExp xrange, yrange;
+            int width = 0, height = 0, power = 0, max_iterations = 0;
+            Arithmetic arithmetic = Arithmetic::Auto;
+            bool complete = false; // The image was finished
+            long iterations = 0; // The iterations of the whole image, had it been computed at once
+        } last;
+        // What start_render() found the next image can keep of the last one.
+        struct Reuse {
+            int resume_from = 0; // The same view with these fewer iterations
+            bool shifted = false; // The same view moved by (dx, dy) pixels
+            int dx = 0, dy = 0;
+            bool preview = false; // The window shows the last image resampled to the new view
+        };
+        unsigned image_number; // Counts the images started, to tell which one the counts below belong to
+        std::mutex ready_lock; // Guards the ready_ members and counts_ready
+        std::vector<int> ready_counts;
+        std::vector<float> ready_smooth; // Empty when ready_counts have no fractions
+        Subsamples ready_subsamples; // The points the anti-aliasing added to the finished image
+        int ready_width, ready_height, ready_step, ready_iterations; // The image ready_counts belongs to
+        unsigned ready_image;
+        bool counts_ready;
+
+        // The counts of the image on screen, kept so that a new palette only has to colour them again.
+        std::vector<int> shown_counts;
+        std::vector<float> shown_smooth;
+        Subsamples shown_subsamples;
+        int shown_width, shown_height, shown_step, shown_iterations;
+        unsigned shown_image;
+        std::unique_ptr<Colorizer> colorizer; // For the palette and the iterations of the last image coloured
+
+        void start_render();
+        void stop_render();
+        // Moves the image on screen by (dx, dy) pixels, as the render thread does with its counts.
+        void shift_frame(int dx, int dy);
+        // Shows the counts on screen resampled to the new view, scaled from the one of the last
+        // image, until the tiles of the new image replace them. Returns false when the counts on
+        // screen are not those of the last image.
+        bool show_preview();
+        // Colours shown_counts into the frame and has it painted.
+        void show_counts();
+        // Computes the image of the view in passes, on the render thread, keeping what it can of the
+        // last image.
+        void trace_fractale(const DeepView deep_view, const EscapeParams params, const Reuse reuse);
+        // Prints how many counts differ from a brute force, scalar computation of the same view.
+        void verify(const View& view, const EscapeParams& params, const std::vector<int>& counts);
 
     public:
-        Fractale(int w,int h, const char *name, int _power, int _max_iterations, double _xmin, double _xmax, double _ymin, double _ymax, unsigned short _pixel_step);
+        Fractale(int w,int h, const char *name, int _power, int _max_iterations, double _xmin, double _xmax, double _ymin, double _ymax, unsigned short _pixel_step, const RenderSettings& _settings = RenderSettings());
         Fractale(const Fractale&);
-        inline ~Fractale() {}
-        void trace_fractale();
-        inline void expose() { trace_fractale(); }
+        ~Fractale();
+        void expose();
+        void timerNotify();
         void keyPress(EZKeySym);
+        void buttonPress(int mouse_x, int mouse_y, int button);
+
+        // These setters only schedule a new computation if the value really changes.
+        void setPower(int _power);
+        void setMaxIterations(int _max_iterations);
+        void setPalette(Palette _palette); // Only colours the counts of the image again
+        void setViewport(const Precise& _xmin, const Precise& _ymin, const FloatExp& _xrange, const FloatExp& _yrange);
+        void zoom(int x, int y, double factor); // Zooms around the pixel (x, y), factor > 1 zooms in
 };
 
 class App : public EZDraw {
  private:
   Fractale frac;
  public:
-  App(int power, int max_it)
-   : frac(800, 800, "Mandelbrot fractal", power, max_it, -2., +1, -1.5, +1.5, 2)
+  // The view of the powers other than 2 is centred on the origin, the centre of their symmetries
+  App(int power, int max_it, unsigned short pixel_step = 16, const RenderSettings& settings = RenderSettings())
+   : frac(800, 800, "Mandelbrot fractal", power, max_it, power == 2 ? -2. : -1.5, power == 2 ? +1. : +1.5, -1.5, +1.5, pixel_step, settings)
   {}
 };
 
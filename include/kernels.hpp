@@ -0,0 +1,61 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+// The escape-time kernels compute, for n points c = cr[j] + i ci[j], how many iterations of
+// z = z^power + c (starting at z = 0) are needed for |z| to reach 2, capped at max_iterations.
+// Every kernel gives exactly the same counts; the vector ones only compute several points at once.
+// z^power is computed by exponentiation by squaring, with a chain unrolled at compile time for the
+// powers up to 8.
+enum class KernelType { Scalar, AVX2, AVX512 };
+
+struct EscapeParams {
+    int power;
+    int max_iterations;
+    // When positive, an orbit that comes back this close to one of its earlier values is taken as
+    // periodic and its point as inside the set (count = max_iterations). 0 disables the detection.
+    double period_tolerance;
+};
+
+// Returns how many of the points were classified as inside by the detection of cycles. When zr and
+// zi are given, the point j goes on from z = zr[j] + i zi[j] after counts[j] iterations instead of
+// starting at 0, as the points that reached a lower max_iterations, and they receive its last z.
+// When smooth is given, it receives the fraction of an iteration that makes the count of a point
+// that escaped continuous, 1 - log_power(log2 |z|) from its last z, in [0, 1]; 0 for the others.
+typedef int (*EscapeKernel)(const EscapeParams& params, const double *cr, const double *ci, int n, int *counts,
+                            double *zr, double *zi, float *smooth);
+
+// The same computation in double-double precision, for the views too deep for doubles: the point j
+// is c = (cr_hi[j] + cr_lo[j]) + i (ci_hi[j] + ci_lo[j]), and z is kept as the sum of two doubles.
+typedef int (*DoubleDoubleKernel)(const EscapeParams& params, const double *cr_hi, const double *cr_lo,
+                                  const double *ci_hi, const double *ci_lo, int n, int *counts);
+
+// The double-double hi + lo closest to (a_hi + a_lo) + b, where |b| <= |a_hi|.
+inline void double_double_add(double a_hi, double a_lo, double b, double& hi, double& lo) {
+    const double s = a_hi + b, e = b - (s - a_hi) + a_lo;
+    hi = s + e;
+    lo = e - (hi - s);
+}
+
+// For the power 2, tells if c lies in the main cardioid or in the period-2 bulb of the Mandelbrot
+// set. Such points never escape, so they can be classified without iterating.
+inline bool in_cardioid_or_bulb(double cr, double ci) {
+    const double x = cr - 0.25, y2 = ci * ci, q = x * x + y2;
+    if (q * (q + x) <= 0.25 * y2) return true; // The main cardioid
+    return (cr + 1.) * (cr + 1.) + y2 <= 0.0625; // The disk of radius 1/4 centered on -1
+}
+
+// The fastest kernel the processor running the program supports, found from CPUID.
+KernelType detect_kernel();
+// Returns false if the processor does not support the requested kernel.
+bool kernel_supported(KernelType type);
+// The kernel of this type specialized for the power, params.power must be the same.
+EscapeKernel get_kernel(KernelType type, int power);
+// The same kernel computing in single precision, with twice as many points per vector.
+EscapeKernel get_float_kernel(KernelType type, int power);
+// The double-double kernel of this type specialized for the power.
+DoubleDoubleKernel get_double_double_kernel(KernelType type, int power);
+const char *kernel_name(KernelType type);
+// Parses "scalar", "avx2" or "avx512", returns false for any other name.
+bool parse_kernel(const char *name, KernelType& type);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PALETTE_HPP
+#define PALETTE_HPP
+
+#include "ez-draw++.hpp"
+#include "render_pool.hpp"
+#include <cstdint>
+#include <vector>
+
+// How the counts of an image are turned into colours.
+enum class Palette {
+    Bands,    // Blue up to half the iterations, cyan beyond, black inside: the colours of the first versions
+    Gradient, // A cycle of colours along the counts, black inside
+    Grey      // From black to white with the logarithm of the count, black inside
+};
+
+const char *palette_name(Palette palette);
+// Parses "bands", "gradient" or "grey", returns false for any other name.
+bool parse_palette(const char *name, Palette& palette);
+// The palette after this one, back to the first after the last.
+Palette next_palette(Palette palette);
+
+// The colours of a palette for the counts 0 ... max_iterations, computed once: colouring an image is
+// then a lookup per pixel, and a new palette does not need new counts.
+class Colorizer {
+    private:
+        Palette palette;
+        int max_iterations;
+        std::vector<uint32_t> table; // The RGBA bytes of the colour of every count
+
+        void colorize_rows(const int *counts, const float *smooth, int width, int step, int first, int last,
+                           EZuint8 *rgba) const;
+
+    public:
+        Colorizer(Palette _palette, int _max_iterations);
+
+        inline Palette get_palette() const { return palette; }
+        inline int get_max_iterations() const { return max_iterations; }
+
+        // Writes the RGBA bytes of the width x height counts[y * width + x] to rgba. With step > 1,
+        // every pixel takes the colour of the top left corner of its step x step block, as in the
+        // coarse passes of an image. smooth, when given, holds the fraction of an iteration to add
+        // to the count of every pixel that escaped: its colour is blended with the next count's. The
+        // rows are shared among the threads of pool when one is given.
+        void colorize(const int *counts, const float *smooth, int width, int height, int step, EZuint8 *rgba,
+                      RenderPool *pool = nullptr) const;
+        // Averages the colour of each of the n pixels[k] of rgba, coloured by colorize() with a step
+        // of 1, with the colours of the per_pixel counts[k * per_pixel] ... of its other points,
+        // blended by their fractions in smooth as colorize() does when it is given.
+        void supersample(const int *pixels, const int *counts, const float *smooth, int n, int per_pixel,
+                         EZuint8 *rgba) const;
+};
+
+#endif
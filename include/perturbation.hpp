@@ -0,0 +1,113 @@
+#ifndef PERTURBATION_HPP
+#define PERTURBATION_HPP
+
+#include "kernels.hpp"
+#include "precise.hpp"
+#include "render_pool.hpp"
+#include "renderer.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Past a certain zoom, the coordinates of neighbouring pixels can no longer be told apart in double
+// precision. The perturbation computes the orbit of one reference point of the view in high
+// precision, then iterates every pixel as the difference dz = z - Z between its orbit and the
+// reference one, which stays small enough for doubles:
+//     dz' = (Z + dz)^power - Z^power + dc, with dc = c - C the offset of the pixel from the reference.
+
+// Below this size of a pixel, relative to the coordinates of the view, the double-precision kernels
+// start losing the detail of the image.
+const double DOUBLE_PRECISION_LIMIT = 1e-13;
+// The same for the double-double kernels, with the bits their iterations lose.
+const double DOUBLE_DOUBLE_PRECISION_LIMIT = 1e-28;
+// The single-precision kernels are only used on views whose pixels are at least this large, and up
+// to this many iterations: the rounding errors of floats grow with every iteration.
+const double FLOAT_PRECISION_LIMIT = 1e-3;
+const int FLOAT_MAX_ITERATIONS = 100;
+
+// How the counts of a view are computed.
+enum class Arithmetic {
+    Auto,         // The cheapest of the others that can still tell the pixels of the view apart
+    Float,        // The escape-time kernels in single precision
+    Double,       // The escape-time kernels
+    DoubleDouble, // The escape-time kernels in double-double precision
+    Perturbation  // Double-precision deltas against high-precision reference orbits
+};
+
+const char *arithmetic_name(Arithmetic arithmetic);
+// Parses "auto", "float", "double", "double-double" or "perturbation", returns false for any other name.
+bool parse_arithmetic(const char *name, Arithmetic& arithmetic);
+
+// A view given by its corner in high precision and the size of its pixels. As in View, the real
+// part follows the vertical axis of the window and the imaginary part the horizontal one.
+struct DeepView {
+    int width, height;
+    Precise xmin, ymin;
+    FloatExp xscale, yscale; // Past 1e-308, too small for doubles
+
+    inline Precise re(int y) const { return xmin + Precise(y * xscale, xmin.precision()); }
+    inline Precise im(int x) const { return ymin + Precise(x * yscale, ymin.precision()); }
+    // The size of the pixels relative to the coordinates of the centre, or to 1 near the origin.
+    double relative_spacing() const;
+};
+
+// The arithmetic Auto stands for with this view and these iterations: Float, Double, DoubleDouble or
+// Perturbation.
+Arithmetic choose_arithmetic(const DeepView& view, const EscapeParams& params);
+
+// Iterations of the reference orbit from an index m, linearized: as long as |dz_m| < radius, the
+// powers of dz are too small to matter, and l iterations later dz_{m+l} = A dz_m + B dc.
+struct BilinearStep {
+    double a_re, a_im, b_re, b_im, radius;
+};
+
+// The orbit Z_0 = 0, Z_1, ... of the point of a pixel, computed in high precision and kept rounded
+// to doubles. It stops at the first value that escapes, or after max_iterations.
+struct ReferenceOrbit {
+    int x, y; // The pixel of the reference point
+    std::vector<double> re, im;
+    // steps[k][i] covers the 2^(k+1) iterations from the index 1 + i 2^(k+1), and ends before the
+    // last index. Single iterations are not worth a step.
+    std::vector<std::vector<BilinearStep>> steps;
+
+    ReferenceOrbit(const DeepView& view, const EscapeParams& params, int _x, int _y);
+    inline int length() const { return re.size(); }
+};
+
+// Computes the pixels of a view by perturbation. The pixels are iterated against a reference at the
+// centre of the view. When |z| gets smaller than |dz|, the pixel is rebased: it goes on from the
+// start of the reference orbit with dz = z. A pixel that outlives the reference orbit is glitched;
+// it is computed again against a reference taken among the glitched pixels. While dz is small
+// enough, the steps of the reference skip many iterations at once.
+class Perturbation {
+    private:
+        const DeepView view;
+        const EscapeParams params;
+        const KernelType type; // The vector instructions used for the power 2
+        std::vector<double> binomial; // binomial[k] = C(power, k)
+        std::vector<std::unique_ptr<ReferenceOrbit>> references; // The first one is at the centre
+
+        mutable std::atomic<long> iterations{0}, skipped{0}; // The iterations of the pixels, and those the steps skipped
+
+        std::mutex lock;
+        std::vector<int> glitched; // The indices y * width + x of the glitched pixels, guarded by lock
+
+        // Computes the n pixels whose indices are given against the reference, and adds to found
+        // those that outlived it.
+        void iterate(const ReferenceOrbit& reference, const int *pixels, int n, int *counts, std::vector<int>& found) const;
+
+    public:
+        Perturbation(const DeepView& _view, const EscapeParams& _params, KernelType _type);
+
+        // Computes the n pixels whose indices y * width + x are given against the central reference.
+        // It may be called from several threads at once.
+        void compute(const int *pixels, int n, int *counts);
+        // Computes the pixels found glitched so far again, against other references.
+        void fix_glitches(RenderPool& pool, const Sampler& sampler);
+        inline int reference_count() const { return references.size(); }
+        inline long skipped_iterations() const { return skipped; }
+        inline long total_iterations() const { return iterations; }
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef PRECISE_HPP
+#define PRECISE_HPP
+
+#include "floatexp.hpp"
+#include <cstdint>
+
+// The numbers of the deep zooms: the corner of the view and the reference orbits, which need
+// hundreds of bits. They are fixed-point numbers in two's complement, made of 64-bit limbs: the
+// first limb is the integer part, the next ones hold 64 more bits of fraction each. The values of
+// an orbit stay small, so unlike a floating point type there is no exponent to align or normalize,
+// and an addition is a single pass of carries.
+// The number of limbs is chosen at run time, from the depth of the zoom. An operation is done with
+// the precision of its most precise operand; the products are truncated, so their last limb may be
+// off by a few units.
+class Precise {
+    public:
+        static const int MAX_LIMBS = 32; // 64 bits of integer part and 1984 of fraction
+        static const int DEFAULT_LIMBS = 2; // What a double converts to
+
+    private:
+        uint64_t limb[MAX_LIMBS]; // The most significant first, only the first limbs are used
+        int limbs;
+
+        bool negative() const { return int64_t(limb[0]) < 0; }
+        Precise magnitude() const;
+
+    public:
+        Precise(double value = 0, int _limbs = DEFAULT_LIMBS);
+        // Also exact for the values too small for a double, down to the last limb.
+        Precise(const FloatExp& value, int _limbs);
+
+        inline int precision() const { return limbs; }
+        // Changes the number of limbs, truncating the value or extending it with zeros.
+        void set_precision(int _limbs);
+        // The number of limbs needed to tell apart points this far from each other, with enough
+        // guard bits for the rounding errors of a reference orbit.
+        static int precision_for(const FloatExp& spacing);
+
+        explicit operator double() const;
+        // Also exact for the values too small for a double, as the differences of two corners.
+        explicit operator FloatExp() const;
+
+        Precise operator-() const;
+        friend Precise operator+(const Precise& a, const Precise& b);
+        friend Precise operator-(const Precise& a, const Precise& b);
+        friend Precise operator*(const Precise& a, const Precise& b);
+        // a * a, with about half the limb products of the general multiplication.
+        friend Precise square(const Precise& a);
+        friend bool operator==(const Precise& a, const Precise& b);
+};
+
+#endif
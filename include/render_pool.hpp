@@ -0,0 +1,53 @@
+#ifndef RENDER_POOL_HPP
+#define RENDER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed pool of worker threads that runs batches of independent jobs (the tiles of an image).
+// Each worker owns a queue filled with a contiguous slice of the batch; a worker that runs out of
+// jobs steals from the far end of another worker's queue, so expensive tiles (the inside of the
+// set) do not leave the other cores idle.
+class RenderPool {
+    private:
+        struct Queue {
+            std::mutex lock;
+            std::deque<size_t> jobs;
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        std::mutex lock;
+        std::condition_variable wake, finished;
+        unsigned generation; // Incremented for every batch, so the workers know there is work
+        bool stopping;
+
+        std::atomic<const std::function<void(size_t)>*> current; // The job of the current batch
+        std::atomic<size_t> remaining, completed;
+
+        bool pop(unsigned id, size_t& job);
+        void worker_loop(unsigned id);
+
+    public:
+        explicit RenderPool(unsigned threads = 0); // 0 means one thread per hardware core
+        RenderPool(const RenderPool&) = delete;
+        RenderPool& operator=(const RenderPool&) = delete;
+        ~RenderPool();
+
+        inline unsigned size() const { return workers.size(); }
+
+        // Runs job(0) ... job(count - 1) on the workers and returns once all of them are done.
+        // progress(done) is called regularly from the calling thread while the batch is running.
+        void run(size_t count, const std::function<void(size_t)>& job,
+                 const std::function<void(size_t)>& progress = nullptr);
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef RENDERER_HPP
+#define RENDERER_HPP
+
+#include "kernels.hpp"
+#include "render_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+class Perturbation;
+struct DeepView;
+
+// The side of the square tiles handed out to the worker threads, in pixels.
+const int TILE_SIZE = 32;
+
+// The ways of computing the counts of a whole image.
+enum class RenderMode {
+    Brute,          // Every pixel goes through the kernel
+    MarianiSilver,  // Rectangles whose border has a single count are filled without computing their inside
+    BoundaryTrace,  // Only the edges of the regions of equal count are computed, their inside is filled
+    SolidGuess      // Refines a coarse grid, guessing the pixels whose coarser neighbours have a single count
+};
+
+const char *mode_name(RenderMode mode);
+// Parses "brute", "mariani", "boundary" or "guess", returns false for any other name.
+bool parse_mode(const char *name, RenderMode& mode);
+
+// How the solid guessing computes the tiles.
+struct GuessSettings {
+    int block = 8; // The step of the first grid, rounded down to a power of 2
+    int audit = 0; // One guessed pixel in audit is computed to check its guess, 0 checks none
+};
+
+// The part of the plane seen through the window. As the program always did, the real part of c
+// follows the vertical axis of the window and the imaginary part the horizontal one.
+struct View {
+    int width, height;
+    double xmin, xmax, ymin, ymax;
+
+    inline double xscale() const { return (xmax - xmin) / width; }
+    inline double yscale() const { return (ymax - ymin) / height; }
+    inline double re(int y) const { return y * xscale() + xmin; }
+    inline double im(int x) const { return x * yscale() + ymin; }
+};
+
+// What a computation of the image did, printed once it is finished.
+struct RenderStats {
+    std::atomic<long> pixels{0};
+    std::atomic<long> filled{0}; // Pixels given the count of their surroundings without being computed
+    std::atomic<long> interior_shortcuts{0}; // Pixels found in the main cardioid or the period-2 bulb
+    std::atomic<long> periodic{0}; // Pixels whose orbit was found periodic before max_iterations
+    std::atomic<long> glitches{0}; // Pixels computed again by the perturbation against another reference
+    std::atomic<long> audited{0}; // Guessed pixels computed afterwards to check the solid guessing
+    std::atomic<long> guess_errors{0}; // Those whose guess was wrong
+    std::atomic<long> resumed{0}; // Pixels that went on from where the image with fewer iterations left them
+    long moved = 0; // Pixels of the previous image kept by a move of the view, not counted in pixels
+    std::atomic<long> mirrored{0}; // Pixels copied from their images by the symmetries of the set, not counted in pixels
+    std::atomic<long> iterations{0}; // Run by the kernels in single and double precision
+    std::atomic<long> supersampled{0}; // Pixels on the edges of the counts, given SUBSAMPLES more points
+    std::atomic<long> supersample_iterations{0}; // The iterations of their points
+    int references = 0; // Reference orbits computed by the perturbation
+    int reference_bits = 0; // The bits of fraction of their high-precision numbers
+    double skipped = 0; // The fraction of the iterations of the perturbation skipped by the steps of the references
+    double seconds = 0;
+
+    void print(std::ostream& os) const;
+};
+
+// The points the anti-aliasing adds to a pixel on an edge of the counts, one in each quarter of it.
+const int SUBSAMPLES = 4;
+
+// The counts of the points the anti-aliasing added to some pixels of an image: the pixel
+// pixels[k] has the counts counts[k * SUBSAMPLES] ... counts[(k + 1) * SUBSAMPLES - 1], besides its own,
+// and their fractions of an iteration at the same places in smooth when the sampler has them.
+struct Subsamples {
+    std::vector<int> pixels, counts;
+    std::vector<float> smooth;
+};
+
+// The last z of the orbit of every pixel, at y * width + x, so that a higher max_iterations only has
+// to go on with the pixels that reached the previous one. NaN for the pixels given a count without
+// being iterated.
+struct FinalOrbits {
+    std::vector<double> re, im;
+};
+
+// Computes the counts of pixels of a view with a kernel, in double-double precision or by
+// perturbation for the deep zooms, and stores them at counts[y * width + x]. It is shared by the
+// worker threads, which must work on different pixels.
+class Sampler {
+    private:
+        EscapeKernel kernel;
+        DoubleDoubleKernel double_double_kernel;
+        double re_hi, re_lo, im_hi, im_lo; // The corner of deep as double-doubles
+
+        void compute_double_double(const int *pixels, int n) const;
+
+    public:
+        const View view;
+        const EscapeParams params;
+        int *const counts;
+        RenderStats& stats;
+        const std::atomic<bool> *const cancel; // Once it is true, compute() returns without computing anything
+        Perturbation *const perturbation; // When set, it computes the pixels instead of the kernel
+        const DeepView *const deep; // When set, the pixels of this view are computed by the double-double kernel
+        // When set, the kernel keeps the last z of the pixels there, and the pixels whose z is known
+        // go on from it and from their count. Not with the perturbation or the double-double kernel.
+        FinalOrbits *const orbits;
+        // When set, receives the fraction of an iteration of every pixel, next to its count, for the
+        // smooth colouring. The pixels filled without being computed get it from their surroundings.
+        // Not with the perturbation or the double-double kernel.
+        float *const smooth;
+
+        Sampler(const View& _view, const EscapeParams& _params, KernelType type, int *_counts, RenderStats& _stats,
+                const std::atomic<bool> *_cancel = nullptr, Perturbation *_perturbation = nullptr,
+                const DeepView *_deep = nullptr, bool single_precision = false, FinalOrbits *_orbits = nullptr,
+                float *_smooth = nullptr);
+
+        // Computes the n pixels whose indices y * width + x are given, in any order.
+        void compute(const int *pixels, int n) const;
+        // Computes the counts of the n points re[m] + i im[m], which need not be pixels, into found,
+        // and their fractions of an iteration into fractions when it is given. Not with the
+        // perturbation or the double-double kernel.
+        void sample(const double *re, const double *im, int n, int *found, float *fractions = nullptr) const;
+        // Computes the n pixels (x + m dx, y + m dy) for m = 0 ... n - 1.
+        void span(int x, int y, int dx, int dy, int n) const;
+        inline int& at(int x, int y) const { return counts[y * view.width + x]; }
+};
+
+// Called from the worker threads with the corners (x0, y0) and (x1, y1), included, of every tile
+// whose counts are done. The perturbation may still fix some of them once all the tiles are.
+typedef std::function<void(int x0, int y0, int x1, int y1)> TileCallback;
+
+// The conjugate of a point has the conjugate orbit, and the same count, and at odd powers so has its
+// opposite: all these functions only compute the larger side of a view that the real axis crosses,
+// or the imaginary one, and copy the other side from it. At the powers 1 + 4k, the points on both
+// sides of the diagonals through the origin have the same counts as well.
+
+// Fills all the counts of the sampler's view with the given mode. progress(done, total) is called
+// regularly from the calling thread, and tile_done for every tile.
+void render(RenderMode mode, RenderPool& pool, const Sampler& sampler,
+            const std::function<void(size_t, size_t)>& progress = nullptr, const TileCallback& tile_done = nullptr,
+            const GuessSettings& guess = GuessSettings());
+
+// Computes, pixel by pixel, the counts of the pixels whose coordinates are both multiples of step.
+// With refine, the pixels whose coordinates are multiples of 2 * step are taken as computed by the
+// previous pass, so a series of passes with step halving each time computes every pixel once.
+void render_pass(RenderPool& pool, const Sampler& sampler, int step, bool refine,
+                 const std::function<void(size_t, size_t)>& progress = nullptr);
+
+// Turns the counts of the sampler's view computed with previous_iterations into those of its
+// max_iterations, which is higher: the pixels that escaped keep their counts, the others go on from
+// the last z the sampler's orbits kept for them.
+void render_resume(RenderPool& pool, const Sampler& sampler, int previous_iterations,
+                   const std::function<void(size_t, size_t)>& progress = nullptr);
+
+// Turns the counts of the sampler's view one (dx, dy) pixels away into its own: the pixels both
+// views share are moved, with their orbits, and only the strips the move uncovered are computed,
+// with the given mode.
+void render_shifted(RenderMode mode, RenderPool& pool, const Sampler& sampler, int dx, int dy,
+                    const std::function<void(size_t, size_t)>& progress = nullptr, const GuessSettings& guess = GuessSettings());
+
+// Adds SUBSAMPLES points to pixels of the sampler's view, already computed, on the edges between
+// counts, where a single point per pixel shows jagged steps. The edges of the largest steps go
+// first, within about budget iterations. The points are jittered within the quarters of the pixel,
+// around its own point. Not with the perturbation or the double-double kernel.
+void render_subsamples(RenderPool& pool, const Sampler& sampler, long budget, Subsamples& subsamples,
+                       const std::function<void(size_t, size_t)>& progress = nullptr);
+
+// Moves the width x height image pixels[y * width + x] so that the pixel (x, y) takes the value of
+// (x + dx, y + dy); the pixels with no such value get fill. The rows are moved in the order that
+// leaves each one in place until it has been copied.
+template <typename T>
+void shift_image(T *pixels, int width, int height, int dx, int dy, T fill) {
+    const int columns = width - std::abs(dx), to = std::max(-dx, 0), from = std::max(dx, 0);
+    for (int k = 0; k < height; ++k) {
+        const int y = dy >= 0 ? k : height - 1 - k, source = y + dy;
+        T *const row = pixels + size_t(y) * width;
+        if (source < 0 || source >= height || columns <= 0) {
+            std::fill(row, row + width, fill);
+            continue;
+        }
+        std::memmove(row + to, pixels + size_t(source) * width + from, columns * sizeof(T));
+        std::fill(row, row + to, fill);
+        std::fill(row + to + columns, row + width, fill);
+    }
+}
+
+#endif
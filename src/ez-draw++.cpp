@@ -9251,6 +9251,12 @@ EZPixel EZImage::getPixel(int x,int y)
  else return EZPixel(&image->pixels_rgba[(y*image->width+x)*4]);
 }
 
+EZuint8 *EZImage::getPixels()
+{ return image->pixels_rgba; }
+
+const EZuint8 *EZImage::getPixels() const
+{ return image->pixels_rgba; }
+
 void EZImage::paint(EZWindow& win,int x,int y) const
 { ez_image_paint (EZDrawPrivate::recover(&win), image, x, y); }
 
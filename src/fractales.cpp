@@ -2,24 +2,33 @@
 #include <sstream>
 #include <thread>
 #include <cmath>
-#include <complex>
+#include <vector>
+#include <algorithm>
 
-Fractale::Fractale(int w,int h,const char *name, int _power, int _max_iterations, double _xmin, double _xmax, double _ymin, double _ymax, unsigned short _pixel_step)
-    : EZWindow(w,h,name), power(_power), max_iterations(_max_iterations), xmin(_xmin), xmax(_xmax), ymin(_ymin), ymax(_ymax)
-{setDoubleBuffer(true);}
+// How many pixels the arrow keys move the view.
+const int PAN_STEP = 80;
+// How often, in milliseconds, the window looks for a new pass of the render thread.
+const unsigned int POLL_DELAY = 10;
+// A move of the view this close to a whole number of pixels keeps the pixels of the last image.
+const double SHIFT_TOLERANCE = 1e-6;
 
-Fractale::Fractale(const Fractale& fractale) // Copy constructor
-    : Fractale(800, 800, "Fractale", fractale.power, fractale.max_iterations, -3.5, +3.5, -1.2, +1.2, 3)
-{}
+Fractale::Fractale(int w,int h,const char *name, int _power, int _max_iterations, double _xmin, double _xmax, double _ymin, double _ymax, unsigned short _pixel_step, const RenderSettings& _settings)
+    : EZWindow(w,h,name), power(_power), max_iterations(_max_iterations), xmin(_xmin), ymin(_ymin), xrange(_xmax - _xmin), yrange(_ymax - _ymin), pixel_step(1), settings(_settings), pool(_settings.threads), frame_dirty(true),
+      cancel(false), rendering(false), image_number(0), ready_width(0), ready_height(0), ready_step(1), ready_iterations(0),
+      ready_image(0), counts_ready(false), shown_width(0), shown_height(0), shown_step(1), shown_iterations(0), shown_image(0)
+{
+    setDoubleBuffer(true);
+    while (pixel_step * 2 <= _pixel_step) pixel_step *= 2; // The passes halve the step down to 1
+}
 
-std::complex<double> getPower(std::complex<double> z, const int p) {
-    std::complex<double> result = 1; // We start at 1
-    for (int i = 0; i < p; ++i) {
-        result *= z; // We multiply by z p times
-    }
-    return result;
+Fractale::~Fractale() {
+    stop_render(); // The render thread uses the pool and the buffers
 }
 
+Fractale::Fractale(const Fractale& fractale) // Copy constructor
+    : Fractale(800, 800, "Fractale", fractale.power, fractale.max_iterations, -3.5, +3.5, -1.2, +1.2, 3, fractale.settings)
+{}
+
 void display_loading_bar(int time_loading, std::string& sep) {
     std::cout << "\033[0G"; // Put the cursor at the begin of the line
     std::cout << sep;
@@ -27,63 +36,413 @@ void display_loading_bar(int time_loading, std::string& sep) {
     std::cout.flush(); //clean the line
 }
 
-void Fractale::trace_fractale() {
-    std::complex<double> z, c;
+void Fractale::trace_fractale(const DeepView deep_view, const EscapeParams params, const Reuse reuse) {
+    const int width = deep_view.width, height = deep_view.height;
+    const double corner_re = double(deep_view.xmin), corner_im = double(deep_view.ymin);
+    const View view = {width, height, corner_re, corner_re + double(deep_view.xscale) * width,
+                       corner_im, corner_im + double(deep_view.yscale) * height};
+
+    // Shallow views with few iterations are computed in single precision. Once double precision can
+    // no longer tell the pixels apart, they are computed in double-double precision, then by perturbation
+    const Arithmetic arithmetic = settings.arithmetic == Arithmetic::Auto ? choose_arithmetic(deep_view, params)
+                                                                          : settings.arithmetic;
+    std::unique_ptr<Perturbation> perturbation;
+    if (arithmetic == Arithmetic::Perturbation) perturbation = std::make_unique<Perturbation>(deep_view, params, settings.kernel);
+
+    // Only the kernels in single and double precision can go on from the last z of a pixel. The
+    // counts and the orbits of the last image are still there when it is resumed or moved.
+    const bool keeps_orbits = arithmetic == Arithmetic::Float || arithmetic == Arithmetic::Double;
+    const bool resume = reuse.resume_from > 0 && keeps_orbits && arithmetic == last.arithmetic;
+    const bool shift = reuse.shifted && arithmetic == last.arithmetic;
+    last.complete = false;
+    if (!resume && !shift) {
+        orbits.re.assign(keeps_orbits ? width * height : 0, NAN);
+        orbits.im.assign(keeps_orbits ? width * height : 0, NAN);
+        smooth.assign(keeps_orbits ? width * height : 0, 0.f);
+    }
 
-    // We calculate the scale of the fractal, based on the minimum and maximum values for x and y,
-    // and the window size
-    double xscale = (xmax - xmin) / getWidth(), yscale = (ymax - ymin) / getHeight();
     std::string separator = "[        ]";
-    int count, time_loading;
-    std::cout << "In progress. . ." << std::endl;
-    for (int i = 0; i < getWidth(); ++i) {
-        for (int k = 0; k < getHeight(); ++k) {
-            // The loading bar will be "incremented" every 100 pixels scanned.
-            if (i == time_loading * 100 && k == time_loading* 100) display_loading_bar(time_loading, separator);
-            
-            // we calculate the real and imaginary part of the number c, based on the pixel location
-            // and zoom and position values
-            c.real(k * xscale + xmin);
-            c.imag(i * yscale + ymin);
-
-            // we start z at (0, 0)
-            z.real(0.);
-            z.imag(0.);
-
-            count = 0;
-
-            // Iterate until z moves more than 2 units away from (0, 0),
-            // or until we've iterated too many times
-            while ((pow(z.real(),2) + pow(z.imag(), 2) < 4) && (count < max_iterations)) {
-                // Calculate the Mandelbrot function
-
-                // z = z^POWER + c where z and c are complex numbers
-                z = getPower(z, power) + c;
-  
-                // count is the number of iterations
-                count++;
-            }
-  
-            // Display the result as a pixel
-            if (count > max_iterations/2 && count < max_iterations) setColor(EZColor::cyan);
-            else if (count >= max_iterations) setColor(EZColor::black); // If it diverges
-            else setColor(EZColor::blue); // If it converges
-
-            drawPoint(i, k);
+    int time_loading = 0;
+    std::cout << "In progress (" << arithmetic_name(arithmetic) << "). . ." << std::endl;
+    RenderStats stats;
+    const double start = EZDraw::getTime();
+
+    // The loading bar gets one more # every eighth of the tiles of the last pass.
+    const int bar_length = separator.size() - 2;
+    const std::function<void(size_t, size_t)> show_progress = [&](size_t done, size_t total) {
+        while (time_loading < bar_length && done * bar_length >= (time_loading + 1) * total)
+            display_loading_bar(time_loading++, separator);
+    };
+    // Over a preview, the tiles replace it as soon as they are done. ready_counts already holds it.
+    const TileCallback show_tile = [&](int x0, int y0, int x1, int y1) {
+        if (cancel) return; // The tile may not have been computed
+        std::lock_guard<std::mutex> guard(ready_lock);
+        for (int y = y0; y <= y1; ++y)
+            std::copy(&counts[y * width + x0], &counts[y * width + x1 + 1], &ready_counts[y * width + x0]);
+        // The preview may have fractions the new image does not, or the other way round
+        if (smooth.size() != ready_smooth.size()) ready_smooth.clear();
+        else for (int y = y0; y <= y1; ++y)
+            std::copy(&smooth[y * width + x0], &smooth[y * width + x1 + 1], &ready_smooth[y * width + x0]);
+        counts_ready = true;
+    };
+
+    const Sampler sampler(view, params, settings.kernel, counts.data(), stats, &cancel, perturbation.get(),
+                          arithmetic == Arithmetic::DoubleDouble ? &deep_view : nullptr, arithmetic == Arithmetic::Float,
+                          keeps_orbits ? &orbits : nullptr, smooth.empty() ? nullptr : smooth.data());
+
+    // The first pass computes one pixel every pixel_step in both directions, and the next ones
+    // halve the step, computing only the pixels the previous passes did not. The other modes have
+    // their own way of skipping pixels: after the preview, they compute the whole image at once.
+    // A resumed, moved or previewed image already has a preview on screen, and is finished in a
+    // single pass.
+    bool refine = false;
+    for (int step = resume || shift || reuse.preview ? 1 : pixel_step; ; ) {
+        if (resume) render_resume(pool, sampler, reuse.resume_from, show_progress);
+        else if (shift) render_shifted(settings.mode, pool, sampler, reuse.dx, reuse.dy, show_progress, settings.guess);
+        else if (step > 1 || refine) render_pass(pool, sampler, step, refine, step == 1 ? show_progress : nullptr);
+        else render(settings.mode, pool, sampler, show_progress, reuse.preview ? show_tile : nullptr, settings.guess);
+        if (cancel) break;
+
+        // The counts are handed over as they are: the window colours them, until the last pass
+        // with the sample at the top left corner of every step x step block.
+        {
+            std::lock_guard<std::mutex> guard(ready_lock);
+            ready_counts.assign(counts.begin(), counts.end());
+            ready_smooth.assign(smooth.begin(), smooth.end());
+            ready_subsamples = Subsamples();
+            ready_width = width;
+            ready_height = height;
+            ready_step = step;
+            ready_iterations = params.max_iterations;
+            ready_image = image_number;
+            counts_ready = true;
+        }
+
+        if (step == 1) break;
+        refine = settings.mode == RenderMode::Brute;
+        step = refine ? step / 2 : 1;
+    }
+    // Once the image is on screen, its edges get more points, which the window then blends in. The
+    // budget is a part of the work of the whole image, which a move of the view or more
+    // iterations only partly do.
+    const long image_iterations = resume ? last.iterations + stats.iterations : shift ? last.iterations : stats.iterations.load();
+    if (!cancel && settings.antialias > 0 && keeps_orbits) {
+        Subsamples subsamples;
+        render_subsamples(pool, sampler, long(settings.antialias * image_iterations), subsamples);
+        if (!cancel) {
+            std::lock_guard<std::mutex> guard(ready_lock);
+            ready_subsamples = std::move(subsamples);
+            counts_ready = true;
+        }
+    }
+    stats.seconds = EZDraw::getTime() - start;
+    if (perturbation) {
+        stats.references = perturbation->reference_count();
+        stats.reference_bits = 64 * (deep_view.xmin.precision() - 1);
+        if (perturbation->total_iterations() > 0)
+            stats.skipped = double(perturbation->skipped_iterations()) / perturbation->total_iterations();
+    }
+
+    std::cout << "\033[0G" << separator; // We display the end of the loading bar.
+    if (cancel) {
+        std::cout << std::endl << "cancelled" << std::endl;
+    }
+    else {
+        std::cout << std::endl << "finished !" << std::endl;
+        stats.print(std::cout);
+        // The reference is in double precision, which the deeper arithmetics are there to go beyond
+        if (settings.verify && keeps_orbits) verify(view, params, counts);
+        last.arithmetic = arithmetic;
+        last.iterations = image_iterations;
+        last.complete = true;
+    }
+    rendering = false;
+}
+
+void Fractale::start_render() {
+    stop_render();
+
+    const int width = getWidth(), height = getHeight();
+    // When only the maximum of iterations went up since the last image, its pixels that escaped
+    // keep their counts. When the view only moved by whole pixels, the pixels still in the window
+    // keep theirs. trace_fractale() still checks the arithmetic, which depends on both.
+    Reuse reuse;
+    const bool same_size = last.width == width && last.height == height && last.power == power;
+    const bool same_frame = last.complete && same_size && last.xrange == xrange && last.yrange == yrange;
+    if (same_frame && last.xmin == xmin && last.ymin == ymin) {
+        if (max_iterations > last.max_iterations) reuse.resume_from = last.max_iterations;
+    }
+    else if (same_frame && max_iterations == last.max_iterations) {
+        // As everywhere, the real part follows the rows and the imaginary part the columns
+        const double rows = double(FloatExp(xmin - last.xmin) / (xrange / width));
+        const double columns = double(FloatExp(ymin - last.ymin) / (yrange / height));
+        if (std::fabs(columns) < width && std::fabs(rows) < height) {
+            reuse.dx = int(std::lround(columns));
+            reuse.dy = int(std::lround(rows));
+            reuse.shifted = std::fabs(columns - reuse.dx) < SHIFT_TOLERANCE && std::fabs(rows - reuse.dy) < SHIFT_TOLERANCE;
+        }
+    }
+    else if (same_size && max_iterations == last.max_iterations && (last.xrange != xrange || last.yrange != yrange)) {
+        // A zoom, even before the last image is finished: the counts on screen give a preview of
+        // the new view at once
+        reuse.preview = show_preview();
+    }
+    if (reuse.shifted) shift_frame(reuse.dx, reuse.dy);
+    last.xmin = xmin;
+    last.ymin = ymin;
+    last.xrange = xrange;
+    last.yrange = yrange;
+    last.width = width;
+    last.height = height;
+    last.power = power;
+    last.max_iterations = max_iterations;
+
+    counts.resize(width * height);
+    if (!reuse.preview) {
+        ++image_number;
+        counts_ready = false;
+    }
+    rendering = true;
+    render_thread = std::thread(&Fractale::trace_fractale, this, DeepView{width, height, xmin, ymin, xrange / width, yrange / height},
+                                EscapeParams{power, max_iterations, settings.period_tolerance}, reuse);
+    startTimer(POLL_DELAY);
+}
+
+void Fractale::shift_frame(int dx, int dy) {
+    // Only the finished image on screen can be moved: the last pass of the render thread may not
+    // have been picked up yet
+    std::lock_guard<std::mutex> guard(ready_lock);
+    if (counts_ready || !frame || shown_step != 1 || frame->getWidth() != shown_width || frame->getHeight() != shown_height) return;
+    shift_image(shown_counts.data(), shown_width, shown_height, dx, dy, 0);
+    if (!shown_smooth.empty()) shift_image(shown_smooth.data(), shown_width, shown_height, dx, dy, 0.f);
+    // The pixels supersampled still in the window, with their points
+    Subsamples moved;
+    for (size_t k = 0; k < shown_subsamples.pixels.size(); ++k) {
+        const int x = shown_subsamples.pixels[k] % shown_width - dx, y = shown_subsamples.pixels[k] / shown_width - dy;
+        if (x < 0 || x >= shown_width || y < 0 || y >= shown_height) continue;
+        moved.pixels.push_back(y * shown_width + x);
+        moved.counts.insert(moved.counts.end(), &shown_subsamples.counts[k * SUBSAMPLES],
+                            &shown_subsamples.counts[(k + 1) * SUBSAMPLES]);
+        if (!shown_subsamples.smooth.empty())
+            moved.smooth.insert(moved.smooth.end(), &shown_subsamples.smooth[k * SUBSAMPLES],
+                                &shown_subsamples.smooth[(k + 1) * SUBSAMPLES]);
+    }
+    shown_subsamples = std::move(moved);
+    // Black while the render thread computes the strips uncovered
+    shift_image(reinterpret_cast<uint32_t *>(frame->getPixels()), shown_width, shown_height, dx, dy, uint32_t(0));
+    frame_pixmap = std::make_unique<EZPixmap>(*frame);
+}
+
+bool Fractale::show_preview() {
+    const int width = getWidth(), height = getHeight();
+    if (shown_image != image_number || shown_width != width || shown_height != height || shown_counts.empty()) return false;
+
+    // The new pixel (x, y) falls on the pixel (x0 + x kx, y0 + y ky) of the last image, which only
+    // has the samples at the corners of its step x step blocks. Outside of the last image, the
+    // preview is black.
+    const FloatExp last_xscale = last.xrange / width, last_yscale = last.yrange / height;
+    const double y0 = double(FloatExp(xmin - last.xmin) / last_xscale), ky = double(xrange / last.xrange);
+    const double x0 = double(FloatExp(ymin - last.ymin) / last_yscale), kx = double(yrange / last.yrange);
+    std::vector<int> columns(width), preview(shown_counts.size());
+    std::vector<float> preview_smooth(shown_smooth.size());
+    for (int x = 0; x < width; ++x) {
+        const double column = std::floor(x0 + x * kx);
+        columns[x] = column >= 0 && column < width ? int(column) / shown_step * shown_step : -1;
+    }
+    for (int y = 0; y < height; ++y) {
+        const double row = std::floor(y0 + y * ky);
+        int *const out = &preview[y * width];
+        if (!(row >= 0 && row < height)) {
+            std::fill(out, out + width, max_iterations);
+            continue;
+        }
+        const int *const in = &shown_counts[int(row) / shown_step * shown_step * width];
+        for (int x = 0; x < width; ++x) out[x] = columns[x] < 0 ? max_iterations : in[columns[x]];
+        if (preview_smooth.empty()) continue;
+        const float *const fractions = &shown_smooth[int(row) / shown_step * shown_step * width];
+        for (int x = 0; x < width; ++x) preview_smooth[y * width + x] = columns[x] < 0 ? 0.f : fractions[columns[x]];
+    }
+
+    // The preview is the first state of the new image, which its tiles then overwrite in ready_counts
+    ++image_number;
+    {
+        std::lock_guard<std::mutex> guard(ready_lock);
+        ready_counts = preview;
+        ready_smooth = preview_smooth;
+        ready_subsamples = Subsamples();
+        ready_width = width;
+        ready_height = height;
+        ready_step = 1;
+        ready_iterations = max_iterations;
+        ready_image = image_number;
+        counts_ready = false;
+    }
+    shown_counts.swap(preview);
+    shown_smooth.swap(preview_smooth);
+    shown_subsamples = Subsamples();
+    shown_step = 1;
+    shown_image = image_number;
+    show_counts();
+    return true;
+}
+
+void Fractale::stop_render() {
+    if (!render_thread.joinable()) return;
+    cancel = true;
+    render_thread.join();
+    cancel = false;
+}
+
+void Fractale::timerNotify() {
+    // rendering is read first: once it is false, the last pass is already in ready_counts
+    const bool running = rendering;
+    bool ready;
+    {
+        std::lock_guard<std::mutex> guard(ready_lock);
+        ready = counts_ready;
+        // Copied rather than swapped: the tiles over a preview are copied into ready_counts one by one
+        if (ready) {
+            shown_counts = ready_counts;
+            shown_smooth = ready_smooth;
+            shown_subsamples = ready_subsamples;
+            shown_width = ready_width;
+            shown_height = ready_height;
+            shown_step = ready_step;
+            shown_iterations = ready_iterations;
+            shown_image = ready_image;
         }
+        counts_ready = false;
     }
-    
-    display_loading_bar(time_loading, separator); // We display the end of the loading bar.
-    std::cout << std::endl << "finished !" << std::endl;
+    if (ready) show_counts();
+    if (running) startTimer(POLL_DELAY);
+}
+
+void Fractale::show_counts() {
+    // After a resize, the counts no longer fit the frame: the image of the new size is on its way
+    if (!frame || shown_counts.empty() || frame->getWidth() != shown_width || frame->getHeight() != shown_height) return;
+    if (!colorizer || colorizer->get_palette() != settings.palette || colorizer->get_max_iterations() != shown_iterations)
+        colorizer = std::make_unique<Colorizer>(settings.palette, shown_iterations);
+    // The fractions of an iteration, when the kernels gave them, smooth the steps between the counts
+    const bool smooth_counts = shown_smooth.size() == shown_counts.size();
+    // Only this thread starts the render thread, so once it is done with the pool, the pool is free
+    colorizer->colorize(shown_counts.data(), smooth_counts ? shown_smooth.data() : nullptr, shown_width, shown_height,
+                        shown_step, frame->getPixels(), rendering ? nullptr : &pool);
+    if (shown_step == 1)
+        colorizer->supersample(shown_subsamples.pixels.data(), shown_subsamples.counts.data(),
+                               shown_subsamples.smooth.empty() ? nullptr : shown_subsamples.smooth.data(),
+                               shown_subsamples.pixels.size(), SUBSAMPLES, frame->getPixels());
+    frame_pixmap = std::make_unique<EZPixmap>(*frame);
+    sendExpose();
+}
+
+void Fractale::verify(const View& view, const EscapeParams& params, const std::vector<int>& counts) {
+    // The reference is computed pixel by pixel with the scalar kernel in double precision, which also
+    // shows what the single-precision kernels lose. It takes none of the shortcuts of the renders
+    // (the cardioid, the cycles, the symmetries), so it checks them too.
+    const EscapeParams plain{params.power, params.max_iterations, 0};
+    const EscapeKernel kernel = get_kernel(KernelType::Scalar, params.power);
+    std::vector<int> reference(counts.size());
+    // A new image cancels the verification as it does the render, stop_render() waits for both
+    pool.run(view.height, [&](size_t y) {
+        if (cancel) return;
+        std::vector<double> re(view.width, view.re(y)), im(view.width);
+        for (int x = 0; x < view.width; ++x) im[x] = view.im(x);
+        kernel(plain, re.data(), im.data(), view.width, &reference[y * view.width], nullptr, nullptr, nullptr);
+    });
+    if (cancel) return;
+
+    long mismatches = 0;
+    for (size_t n = 0; n < counts.size(); ++n) mismatches += counts[n] != reference[n];
+    std::cout << "  verification: " << mismatches << " pixels (" << 100. * mismatches / counts.size()
+              << " %) differ from the pixel by pixel image in double precision" << std::endl;
+}
+
+void Fractale::expose() {
+    // A resized window needs a new image of its size
+    if (!frame || frame->getWidth() != getWidth() || frame->getHeight() != getHeight()) {
+        frame = std::make_unique<EZImage>(getWidth(), getHeight());
+        frame_dirty = true;
+    }
+
+    // The fractal is only computed again if it changed, otherwise we just copy the last image. Until
+    // the first pass of a new image is ready, the previous one stays on screen.
+    if (frame_dirty) {
+        start_render();
+        frame_dirty = false;
+    }
+    if (frame_pixmap) frame_pixmap->paint(*this, 0, 0);
+}
+
+void Fractale::setPower(int _power) {
+    if (_power == power) return;
+    power = _power;
+    frame_dirty = true;
+    sendExpose();
+}
+
+void Fractale::setMaxIterations(int _max_iterations) {
+    if (_max_iterations < 1 || _max_iterations == max_iterations) return;
+    max_iterations = _max_iterations;
+    frame_dirty = true;
+    sendExpose();
+}
+
+void Fractale::setPalette(Palette _palette) {
+    if (_palette == settings.palette) return;
+    settings.palette = _palette;
+    show_counts();
+}
+
+void Fractale::setViewport(const Precise& _xmin, const Precise& _ymin, const FloatExp& _xrange, const FloatExp& _yrange) {
+    if (_xmin == xmin && _ymin == ymin && _xrange == xrange && _yrange == yrange) return;
+    xmin = _xmin; ymin = _ymin;
+    xrange = _xrange; yrange = _yrange;
+    // The corner keeps enough bits to tell the pixels apart, and no more: they all cost time in the reference orbits
+    const int limbs = Precise::precision_for(std::min(xrange / getWidth(), yrange / getHeight()));
+    xmin.set_precision(limbs);
+    ymin.set_precision(limbs);
+    frame_dirty = true;
+    sendExpose();
+}
+
+void Fractale::zoom(int x, int y, double factor) {
+    // The point under the pixel stays in place. As in trace_fractale, the real part follows
+    // the vertical axis of the window and the imaginary part the horizontal one. Only the offsets
+    // from the corner are computed as FloatExp, so the corner keeps its precision.
+    const FloatExp dre = y * xrange / getWidth(), dim = x * yrange / getHeight();
+    const int limbs = Precise::precision_for(std::min(xrange / getWidth(), yrange / getHeight()) / factor);
+    setViewport(xmin + Precise(dre - dre / factor, limbs), ymin + Precise(dim - dim / factor, limbs),
+                xrange / factor, yrange / factor);
 }
 
 void Fractale::keyPress(EZKeySym keysym) {
+    const FloatExp xstep = PAN_STEP * xrange / getWidth(), ystep = PAN_STEP * yrange / getHeight();
     switch (keysym) {
         case EZKeySym::Escape:
         case EZKeySym::q :
           EZDraw::quit(); // If the user presses q or Escape, we quit the program
           break;
+        case EZKeySym::Left: setViewport(xmin, ymin - Precise(ystep, ymin.precision()), xrange, yrange); break;
+        case EZKeySym::Right: setViewport(xmin, ymin + Precise(ystep, ymin.precision()), xrange, yrange); break;
+        case EZKeySym::Up: setViewport(xmin - Precise(xstep, xmin.precision()), ymin, xrange, yrange); break;
+        case EZKeySym::Down: setViewport(xmin + Precise(xstep, xmin.precision()), ymin, xrange, yrange); break;
+        case EZKeySym::plus:
+        case EZKeySym::KP_Add: zoom(getWidth() / 2, getHeight() / 2, 2.); break;
+        case EZKeySym::minus:
+        case EZKeySym::KP_Subtract: zoom(getWidth() / 2, getHeight() / 2, 0.5); break;
+        case EZKeySym::c: setPalette(next_palette(settings.palette)); break;
+        case EZKeySym::Prior: setMaxIterations(max_iterations * 2); break; // Page Up
+        case EZKeySym::Next: setMaxIterations(max_iterations / 2); break; // Page Down
+        case EZKeySym::_2: case EZKeySym::_3: case EZKeySym::_4: case EZKeySym::_5:
+        case EZKeySym::_6: case EZKeySym::_7: case EZKeySym::_8: case EZKeySym::_9:
+          setPower(int(keysym) - int(EZKeySym::_0)); // The digits choose the power
+          break;
         default:
           break;
      }
 }
+
+void Fractale::buttonPress(int mouse_x, int mouse_y, int button) {
+    if (button == 1) zoom(mouse_x, mouse_y, 2.); // Left click zooms in
+    else if (button == 3) zoom(mouse_x, mouse_y, 0.5); // Right click zooms out
+}
@@ -0,0 +1,853 @@
+#include "../include/kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#endif
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+// The complex product p = a * b, written with plain operators so that V can be a double as well as
+// a vector of doubles. Every kernel goes through these two functions and the same power chains,
+// and the build disables the contraction of a * b + c into FMA instructions: all the kernels
+// round exactly the same way and give the same counts.
+// The results may alias the operands.
+template <typename V>
+ALWAYS_INLINE void complex_multiply(const V& a_re, const V& a_im, const V& b_re, const V& b_im, V& p_re, V& p_im) {
+    const V re = a_re * b_re - a_im * b_im;
+    p_im = a_re * b_im + a_im * b_re;
+    p_re = re;
+}
+
+template <typename V>
+ALWAYS_INLINE void complex_square(const V& a_re, const V& a_im, V& p_re, V& p_im) {
+    const V cross = a_re * a_im;
+    p_re = a_re * a_re - a_im * a_im;
+    p_im = cross + cross;
+}
+
+// z^P by exponentiation by squaring, the chain of squares and products being unrolled at compile
+// time: z^8 costs three squares instead of seven products.
+template <int P>
+struct ComplexPower {
+    template <typename V>
+    static ALWAYS_INLINE void apply(const V& z_re, const V& z_im, V& p_re, V& p_im) {
+        V h_re, h_im;
+        if constexpr (P == 1) {
+            p_re = z_re;
+            p_im = z_im;
+        }
+        else if constexpr (P % 2 == 0) {
+            ComplexPower<P / 2>::apply(z_re, z_im, h_re, h_im);
+            complex_square(h_re, h_im, p_re, p_im);
+        }
+        else {
+            ComplexPower<P - 1>::apply(z_re, z_im, h_re, h_im);
+            complex_multiply(h_re, h_im, z_re, z_im, p_re, p_im);
+        }
+    }
+};
+
+// The same chain for a power only known at run time (power >= 1), reading its bits from the top:
+// it does the same squares and products as ComplexPower<power>.
+template <typename V>
+ALWAYS_INLINE void complex_power(const V& z_re, const V& z_im, int power, V& p_re, V& p_im) {
+    int bit = 30;
+    while (!(power >> bit & 1)) --bit;
+    p_re = z_re;
+    p_im = z_im;
+    for (--bit; bit >= 0; --bit) {
+        complex_square(p_re, p_im, p_re, p_im);
+        if (power >> bit & 1) complex_multiply(p_re, p_im, z_re, z_im, p_re, p_im);
+    }
+}
+
+// Every kernel is instantiated for the powers 1 to 8; P = 0 is the general version.
+template <int P, typename V>
+ALWAYS_INLINE void power_step(const V& z_re, const V& z_im, int power, V& p_re, V& p_im) {
+    if constexpr (P == 0) complex_power(z_re, z_im, power, p_re, p_im);
+    else ComplexPower<P>::apply(z_re, z_im, p_re, p_im);
+}
+
+// The vector of N lanes of Real, with the operators of GCC's vector extensions. N = 1 gives the
+// scalar kernels the same code as the vector ones.
+template <typename Real, int N>
+struct VectorOf {
+    typedef Real type __attribute__((vector_size(N * sizeof(Real))));
+};
+
+// log2(x) in the positive, normal lanes of a vector of doubles or floats, written with plain
+// operators like complex_multiply so that all the kernels give the same results. With x = m 2^e and
+// m in [sqrt(1/2), sqrt(2)), ln(m) = 2 atanh(s) for s = (m - 1) / (m + 1), whose series is cut
+// after s^9: |s| < 0.18, so it is within about 1e-9, far below what the colours can show.
+template <typename V>
+ALWAYS_INLINE void vector_log2(const V& x, V& log) {
+    typedef std::decay_t<decltype(x[0])> Real;
+    typedef std::conditional_t<sizeof(Real) == 8, int64_t, int32_t> Int;
+    typedef typename VectorOf<Int, sizeof(V) / sizeof(Real)>::type IntV;
+    const int mantissa = sizeof(Real) == 8 ? 52 : 23, bias = sizeof(Real) == 8 ? 1023 : 127;
+
+    const IntV bits = (IntV)x;
+    IntV e = (bits >> mantissa) - bias;
+    V m = (V)((bits & ((Int(1) << mantissa) - 1)) | (Int(bias) << mantissa)); // In [1, 2)
+    const IntV high = m > Real(M_SQRT2);
+    m = high ? m * Real(0.5) : m;
+    e -= high; // The lanes of high are -1
+    const V s = (m - Real(1)) / (m + Real(1)), s2 = s * s;
+    const V ln_m = s * (Real(2) + s2 * (Real(2. / 3) + s2 * (Real(2. / 5) + s2 * (Real(2. / 7) + s2 * Real(2. / 9)))));
+    log = __builtin_convertvector(e, V) + ln_m * Real(M_LOG2E);
+}
+
+// Writes to smooth the fractions of the `used` points of the lanes of r2, the |z|^2 of their last
+// z, 0 for those that did not escape. inverse_log2_power is 1 / log2(power), 0 below the power 2,
+// where the fraction is always 0. Both logarithms are taken in the lanes at once, only for the last
+// z, so they cost little next to the iterations.
+template <typename V, typename Real>
+ALWAYS_INLINE void store_smooth(const V& r2, const int *counts, int used, int max_iterations, Real inverse_log2_power,
+                                float *smooth) {
+    V log2_r2, log2_log2_z;
+    vector_log2(r2, log2_r2);
+    vector_log2(log2_r2 * Real(0.5), log2_log2_z);
+    const V fraction = Real(1) - log2_log2_z * inverse_log2_power;
+    for (int l = 0; l < used; ++l) {
+        const bool escaped = counts[l] < max_iterations && inverse_log2_power > 0;
+        smooth[l] = escaped ? std::min(std::max(float(fraction[l]), 0.f), 1.f) : 0.f;
+    }
+}
+
+// 1 / log2(power) for store_smooth().
+static inline double inverse_log2(int power) {
+    return power >= 2 ? 1. / std::log2(double(power)) : 0.;
+}
+
+// The detection of cycles follows Brent: z is compared at every iteration with a saved value of
+// the orbit, which is replaced each time the count reaches a power of two. An orbit caught in a
+// cycle of any period ends up coming back within period_tolerance of the saved value, and the point
+// is then classified as inside the set without running the remaining iterations.
+
+// The scalar kernel is also instantiated with Real = float, for the single-precision kernels.
+template <int P, typename Real = double>
+static int escape_time_scalar(const EscapeParams& params, const double *cr, const double *ci, int n, int *counts,
+                              double *zr, double *zi, float *smooth) {
+    const int power = params.power, max_iterations = params.max_iterations;
+    const bool check_period = params.period_tolerance > 0;
+    const Real tolerance2 = params.period_tolerance * params.period_tolerance;
+    int periodic = 0;
+
+    for (int j = 0; j < n; ++j) {
+        // we start z at (0, 0), or where the point stopped
+        const Real c_re = cr[j], c_im = ci[j];
+        Real z_re = zr ? zr[j] : 0., z_im = zr ? zi[j] : 0., p_re, p_im;
+        Real saved_re = z_re, saved_im = z_im;
+        const int start = zr ? counts[j] : 0;
+        int count = start, next_save = 2;
+
+        // Iterate until z moves more than 2 units away from (0, 0),
+        // or until we've iterated too many times
+        while (z_re * z_re + z_im * z_im < 4 && count < max_iterations) {
+            // z = z^POWER + c where z and c are complex numbers
+            if (P == 0 && power < 1) {
+                p_re = 1.; // z^0, and the negative powers are taken as 0 as they always were
+                p_im = 0.;
+            }
+            else power_step<P>(z_re, z_im, power, p_re, p_im);
+            z_re = p_re + c_re;
+            z_im = p_im + c_im;
+
+            // count is the number of iterations
+            count++;
+
+            if (check_period) {
+                const Real d_re = z_re - saved_re, d_im = z_im - saved_im;
+                if (d_re * d_re + d_im * d_im < tolerance2) {
+                    count = max_iterations; // The orbit is periodic: the point never escapes
+                    ++periodic;
+                    break;
+                }
+                if (count - start == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+        counts[j] = count;
+        if (zr) {
+            zr[j] = z_re;
+            zi[j] = z_im;
+        }
+        if (smooth) {
+            const typename VectorOf<Real, 1>::type r2 = {z_re * z_re + z_im * z_im};
+            store_smooth(r2, counts + j, 1, max_iterations, Real(inverse_log2(power)), smooth + j);
+        }
+    }
+    return periodic;
+}
+
+#ifdef KERNELS_X86
+
+// The vector kernels compute several points in the lanes of a register. A lane whose point escaped
+// or was found periodic is masked: its z and its count are no longer modified. All the lanes start
+// together, so the count of an active lane is the iteration number plus the count it started from,
+// and the saves of the cycle detection happen at the same counts as in the scalar kernel. Only
+// the lanes of resumed points can start from different counts, and they are also masked once they
+// reach max_iterations.
+
+// When fewer than `lanes` points are left, they are copied to tail and the unused lanes repeat the
+// last point: short runs of points still go through the vector code.
+static inline const double *pad_tail(const double *values, int used, int lanes, double *tail) {
+    if (used == lanes) return values;
+    for (int l = 0; l < lanes; ++l) tail[l] = values[std::min(l, used - 1)];
+    return tail;
+}
+
+static inline const int *pad_tail(const int *values, int used, int lanes, int *tail) {
+    if (used == lanes) return values;
+    for (int l = 0; l < lanes; ++l) tail[l] = values[std::min(l, used - 1)];
+    return tail;
+}
+
+template <int P>
+__attribute__((target("avx2")))
+static int escape_time_avx2(const EscapeParams& params, const double *cr, const double *ci, int n, int *counts,
+                            double *zr, double *zi, float *smooth) {
+    const int power = params.power, max_iterations = params.max_iterations;
+    if (P == 0 && power < 1) return escape_time_scalar<0>(params, cr, ci, n, counts, zr, zi, smooth);
+    const bool check_period = params.period_tolerance > 0;
+    const __m256d four = _mm256_set1_pd(4.), tolerance2 = _mm256_set1_pd(params.period_tolerance * params.period_tolerance);
+    const __m256i limit = _mm256_set1_epi64x(max_iterations);
+    int periodic = 0;
+
+    for (int j = 0; j < n; j += 4) {
+        const int used = std::min(4, n - j);
+        double tail_re[4], tail_im[4];
+        const __m256d c_re = _mm256_loadu_pd(pad_tail(cr + j, used, 4, tail_re)), c_im = _mm256_loadu_pd(pad_tail(ci + j, used, 4, tail_im));
+        __m256d z_re = _mm256_setzero_pd(), z_im = _mm256_setzero_pd(), p_re, p_im;
+        __m256i count = _mm256_setzero_si256();
+        if (zr) {
+            double tail_z_re[4], tail_z_im[4];
+            int tail_count[4];
+            z_re = _mm256_loadu_pd(pad_tail(zr + j, used, 4, tail_z_re));
+            z_im = _mm256_loadu_pd(pad_tail(zi + j, used, 4, tail_z_im));
+            count = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)pad_tail(counts + j, used, 4, tail_count)));
+        }
+        __m256d saved_re = z_re, saved_im = z_im, cycled = _mm256_setzero_pd();
+        int next_save = 2;
+
+        for (int it = 0; it < max_iterations; ++it) {
+            const __m256d inside = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(z_re, z_re), _mm256_mul_pd(z_im, z_im)), four, _CMP_LT_OQ);
+            __m256d active = _mm256_andnot_pd(cycled, inside);
+            if (zr) active = _mm256_and_pd(active, _mm256_castsi256_pd(_mm256_cmpgt_epi64(limit, count)));
+            if (_mm256_movemask_pd(active) == 0) break;
+
+            power_step<P>(z_re, z_im, power, p_re, p_im);
+            z_re = _mm256_blendv_pd(z_re, _mm256_add_pd(p_re, c_re), active);
+            z_im = _mm256_blendv_pd(z_im, _mm256_add_pd(p_im, c_im), active);
+            count = _mm256_sub_epi64(count, _mm256_castpd_si256(active)); // An active lane is all ones, i.e. -1
+
+            if (check_period) {
+                const __m256d d_re = _mm256_sub_pd(z_re, saved_re), d_im = _mm256_sub_pd(z_im, saved_im);
+                const __m256d close = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(d_re, d_re), _mm256_mul_pd(d_im, d_im)), tolerance2, _CMP_LT_OQ);
+                cycled = _mm256_or_pd(cycled, _mm256_and_pd(active, close));
+                if (it + 1 == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, count);
+        const int cycled_lanes = _mm256_movemask_pd(cycled);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = (cycled_lanes >> l & 1) ? max_iterations : int(lanes[l]);
+            periodic += cycled_lanes >> l & 1;
+        }
+        if (smooth)
+            store_smooth(_mm256_add_pd(_mm256_mul_pd(z_re, z_re), _mm256_mul_pd(z_im, z_im)), counts + j, used, max_iterations,
+                         inverse_log2(power), smooth + j);
+        if (zr) {
+            double last_re[4], last_im[4];
+            _mm256_storeu_pd(last_re, z_re);
+            _mm256_storeu_pd(last_im, z_im);
+            std::copy(last_re, last_re + used, zr + j);
+            std::copy(last_im, last_im + used, zi + j);
+        }
+    }
+    return periodic;
+}
+
+template <int P>
+__attribute__((target("avx512f")))
+static int escape_time_avx512(const EscapeParams& params, const double *cr, const double *ci, int n, int *counts,
+                              double *zr, double *zi, float *smooth) {
+    const int power = params.power, max_iterations = params.max_iterations;
+    if (P == 0 && power < 1) return escape_time_scalar<0>(params, cr, ci, n, counts, zr, zi, smooth);
+    const bool check_period = params.period_tolerance > 0;
+    const __m512d four = _mm512_set1_pd(4.), tolerance2 = _mm512_set1_pd(params.period_tolerance * params.period_tolerance);
+    const __m512i one = _mm512_set1_epi64(1), limit = _mm512_set1_epi64(max_iterations);
+    int periodic = 0;
+
+    for (int j = 0; j < n; j += 8) {
+        const int used = std::min(8, n - j);
+        double tail_re[8], tail_im[8];
+        const __m512d c_re = _mm512_loadu_pd(pad_tail(cr + j, used, 8, tail_re)), c_im = _mm512_loadu_pd(pad_tail(ci + j, used, 8, tail_im));
+        __m512d z_re = _mm512_setzero_pd(), z_im = _mm512_setzero_pd(), p_re, p_im;
+        __m512i count = _mm512_setzero_si512();
+        if (zr) {
+            double tail_z_re[8], tail_z_im[8];
+            int tail_count[8];
+            z_re = _mm512_loadu_pd(pad_tail(zr + j, used, 8, tail_z_re));
+            z_im = _mm512_loadu_pd(pad_tail(zi + j, used, 8, tail_z_im));
+            count = _mm512_maskz_cvtepi32_epi64(0xff, _mm256_loadu_si256((const __m256i *)pad_tail(counts + j, used, 8, tail_count)));
+        }
+        __m512d saved_re = z_re, saved_im = z_im;
+        __mmask8 cycled = 0;
+        int next_save = 2;
+
+        for (int it = 0; it < max_iterations; ++it) {
+            __mmask8 active = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(z_re, z_re), _mm512_mul_pd(z_im, z_im)), four, _CMP_LT_OQ) & ~cycled;
+            if (zr) active &= _mm512_cmplt_epi64_mask(count, limit);
+            if (active == 0) break;
+
+            power_step<P>(z_re, z_im, power, p_re, p_im);
+            z_re = _mm512_mask_add_pd(z_re, active, p_re, c_re);
+            z_im = _mm512_mask_add_pd(z_im, active, p_im, c_im);
+            count = _mm512_mask_add_epi64(count, active, count, one);
+
+            if (check_period) {
+                const __m512d d_re = _mm512_sub_pd(z_re, saved_re), d_im = _mm512_sub_pd(z_im, saved_im);
+                cycled |= _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(_mm512_mul_pd(d_re, d_re), _mm512_mul_pd(d_im, d_im)), tolerance2, _CMP_LT_OQ);
+                if (it + 1 == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        int64_t lanes[8];
+        _mm512_storeu_si512(lanes, count);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = (cycled >> l & 1) ? max_iterations : int(lanes[l]);
+            periodic += cycled >> l & 1;
+        }
+        if (smooth)
+            store_smooth(_mm512_add_pd(_mm512_mul_pd(z_re, z_re), _mm512_mul_pd(z_im, z_im)), counts + j, used, max_iterations,
+                         inverse_log2(power), smooth + j);
+        if (zr) {
+            double last_re[8], last_im[8];
+            _mm512_storeu_pd(last_re, z_re);
+            _mm512_storeu_pd(last_im, z_im);
+            std::copy(last_re, last_re + used, zr + j);
+            std::copy(last_im, last_im + used, zi + j);
+        }
+    }
+    return periodic;
+}
+
+#endif
+
+// The double-double kernels keep every number as the unevaluated sum hi + lo of two doubles, with
+// |lo| at most half an ulp of hi: about 106 bits of mantissa, enough for views some 10^15 times
+// deeper than the double kernels, without the reference orbits and the glitches of the
+// perturbation, for several times the cost of the double kernels. The operations
+// are those of Dekker and Knuth, written with plain operators like complex_multiply so that the
+// same code runs on doubles and on vectors of doubles. The rounding error of a product is found
+// exactly, with an FMA where AVX-512 guarantees one and by splitting the factors elsewhere: every
+// kernel still gives the same counts.
+template <typename V>
+struct DoubleDouble {
+    V hi, lo;
+};
+
+#ifdef KERNELS_X86
+// The vectors of the double-double kernels, without the may_alias attribute of __m256d and __m512d
+// that a template argument would drop.
+typedef double Double4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+#endif
+
+// s + e = a + b exactly, when |a| >= |b| or a = 0.
+template <typename V>
+ALWAYS_INLINE DoubleDouble<V> quick_two_sum(const V& a, const V& b) {
+    const V s = a + b;
+    return {s, b - (s - a)};
+}
+
+// The additions only keep the error of the high parts: the low parts are summed in plain doubles.
+// Their error stays far below the pixels of the views these kernels are used for.
+template <typename V>
+ALWAYS_INLINE DoubleDouble<V> operator+(const DoubleDouble<V>& a, const DoubleDouble<V>& b) {
+    const V s = a.hi + b.hi, v = s - a.hi;
+    const V e = (a.hi - (s - v)) + (b.hi - v);
+    return quick_two_sum(s, e + (a.lo + b.lo));
+}
+
+template <typename V>
+ALWAYS_INLINE DoubleDouble<V> operator-(const DoubleDouble<V>& a, const DoubleDouble<V>& b) {
+    const V s = a.hi - b.hi, v = s - a.hi;
+    const V e = (a.hi - (s - v)) - (b.hi + v);
+    return quick_two_sum(s, e + (a.lo - b.lo));
+}
+
+// Splits a into two halves of 26 bits, whose products are exact.
+template <typename V>
+ALWAYS_INLINE void split(const V& a, V& high, V& low) {
+    const V t = a * 134217729.; // 2^27 + 1
+    high = t - (t - a);
+    low = a - high;
+}
+
+// p + e = a * b exactly.
+template <typename V>
+ALWAYS_INLINE void two_product(const V& a, const V& b, V& p, V& e) {
+    V a_high, a_low, b_high, b_low;
+    split(a, a_high, a_low);
+    split(b, b_high, b_low);
+    p = a * b;
+    e = ((a_high * b_high - p) + a_high * b_low + a_low * b_high) + a_low * b_low;
+}
+
+#ifdef KERNELS_X86
+// Not always_inline: it can only be inlined once the operators are, into the AVX-512 kernel.
+__attribute__((target("avx512f")))
+inline void two_product(const Double8& a, const Double8& b, Double8& p, Double8& e) {
+    p = a * b;
+    e = _mm512_fmsub_pd(a, b, p);
+}
+#endif
+
+template <typename V>
+ALWAYS_INLINE DoubleDouble<V> operator*(const DoubleDouble<V>& a, const DoubleDouble<V>& b) {
+    V p, e;
+    two_product(a.hi, b.hi, p, e);
+    return quick_two_sum(p, e + (a.hi * b.lo + a.lo * b.hi));
+}
+
+template <int P>
+static int escape_time_double_double_scalar(const EscapeParams& params, const double *cr_hi, const double *cr_lo,
+                                            const double *ci_hi, const double *ci_lo, int n, int *counts) {
+    typedef DoubleDouble<double> DD;
+    const int power = params.power, max_iterations = params.max_iterations;
+    const bool check_period = params.period_tolerance > 0;
+    const double tolerance2 = params.period_tolerance * params.period_tolerance;
+    int periodic = 0;
+
+    for (int j = 0; j < n; ++j) {
+        const DD c_re = {cr_hi[j], cr_lo[j]}, c_im = {ci_hi[j], ci_lo[j]};
+        DD z_re = {0., 0.}, z_im = {0., 0.}, p_re, p_im;
+        DD saved_re = {0., 0.}, saved_im = {0., 0.};
+        int count = 0, next_save = 2;
+
+        // The escape only needs the high parts
+        while (z_re.hi * z_re.hi + z_im.hi * z_im.hi < 4 && count < max_iterations) {
+            if (P == 0 && power < 1) {
+                p_re = {1., 0.};
+                p_im = {0., 0.};
+            }
+            else power_step<P>(z_re, z_im, power, p_re, p_im);
+            z_re = p_re + c_re;
+            z_im = p_im + c_im;
+            count++;
+
+            if (check_period) {
+                const double d_re = (z_re - saved_re).hi, d_im = (z_im - saved_im).hi;
+                if (d_re * d_re + d_im * d_im < tolerance2) {
+                    count = max_iterations;
+                    ++periodic;
+                    break;
+                }
+                if (count == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+        counts[j] = count;
+    }
+    return periodic;
+}
+
+#ifdef KERNELS_X86
+
+template <int P>
+__attribute__((target("avx2")))
+static int escape_time_double_double_avx2(const EscapeParams& params, const double *cr_hi, const double *cr_lo,
+                                          const double *ci_hi, const double *ci_lo, int n, int *counts) {
+    typedef DoubleDouble<Double4> DD;
+    const int power = params.power, max_iterations = params.max_iterations;
+    if (P == 0 && power < 1) return escape_time_double_double_scalar<0>(params, cr_hi, cr_lo, ci_hi, ci_lo, n, counts);
+    const bool check_period = params.period_tolerance > 0;
+    const __m256d four = _mm256_set1_pd(4.), tolerance2 = _mm256_set1_pd(params.period_tolerance * params.period_tolerance);
+    int periodic = 0;
+
+    for (int j = 0; j < n; j += 4) {
+        const int used = std::min(4, n - j);
+        double tail[4][4];
+        const DD c_re = {_mm256_loadu_pd(pad_tail(cr_hi + j, used, 4, tail[0])), _mm256_loadu_pd(pad_tail(cr_lo + j, used, 4, tail[1]))};
+        const DD c_im = {_mm256_loadu_pd(pad_tail(ci_hi + j, used, 4, tail[2])), _mm256_loadu_pd(pad_tail(ci_lo + j, used, 4, tail[3]))};
+        const Double4 zero = _mm256_setzero_pd();
+        DD z_re = {zero, zero}, z_im = {zero, zero}, p_re, p_im;
+        DD saved_re = {zero, zero}, saved_im = {zero, zero};
+        __m256d cycled = _mm256_setzero_pd();
+        __m256i count = _mm256_setzero_si256();
+        int next_save = 2;
+
+        for (int it = 0; it < max_iterations; ++it) {
+            const __m256d inside = _mm256_cmp_pd(z_re.hi * z_re.hi + z_im.hi * z_im.hi, four, _CMP_LT_OQ);
+            const __m256d active = _mm256_andnot_pd(cycled, inside);
+            if (_mm256_movemask_pd(active) == 0) break;
+
+            power_step<P>(z_re, z_im, power, p_re, p_im);
+            const DD next_re = p_re + c_re, next_im = p_im + c_im;
+            z_re = {_mm256_blendv_pd(z_re.hi, next_re.hi, active), _mm256_blendv_pd(z_re.lo, next_re.lo, active)};
+            z_im = {_mm256_blendv_pd(z_im.hi, next_im.hi, active), _mm256_blendv_pd(z_im.lo, next_im.lo, active)};
+            count = _mm256_sub_epi64(count, _mm256_castpd_si256(active));
+
+            if (check_period) {
+                const Double4 d_re = (z_re - saved_re).hi, d_im = (z_im - saved_im).hi;
+                const __m256d close = _mm256_cmp_pd(d_re * d_re + d_im * d_im, tolerance2, _CMP_LT_OQ);
+                cycled = _mm256_or_pd(cycled, _mm256_and_pd(active, close));
+                if (it + 1 == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, count);
+        const int cycled_lanes = _mm256_movemask_pd(cycled);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = (cycled_lanes >> l & 1) ? max_iterations : int(lanes[l]);
+            periodic += cycled_lanes >> l & 1;
+        }
+    }
+    return periodic;
+}
+
+template <int P>
+__attribute__((target("avx512f")))
+static int escape_time_double_double_avx512(const EscapeParams& params, const double *cr_hi, const double *cr_lo,
+                                            const double *ci_hi, const double *ci_lo, int n, int *counts) {
+    typedef DoubleDouble<Double8> DD;
+    const int power = params.power, max_iterations = params.max_iterations;
+    if (P == 0 && power < 1) return escape_time_double_double_scalar<0>(params, cr_hi, cr_lo, ci_hi, ci_lo, n, counts);
+    const bool check_period = params.period_tolerance > 0;
+    const __m512d four = _mm512_set1_pd(4.), tolerance2 = _mm512_set1_pd(params.period_tolerance * params.period_tolerance);
+    const __m512i one = _mm512_set1_epi64(1);
+    int periodic = 0;
+
+    for (int j = 0; j < n; j += 8) {
+        const int used = std::min(8, n - j);
+        double tail[4][8];
+        const DD c_re = {_mm512_loadu_pd(pad_tail(cr_hi + j, used, 8, tail[0])), _mm512_loadu_pd(pad_tail(cr_lo + j, used, 8, tail[1]))};
+        const DD c_im = {_mm512_loadu_pd(pad_tail(ci_hi + j, used, 8, tail[2])), _mm512_loadu_pd(pad_tail(ci_lo + j, used, 8, tail[3]))};
+        const Double8 zero = _mm512_setzero_pd();
+        DD z_re = {zero, zero}, z_im = {zero, zero}, p_re, p_im;
+        DD saved_re = {zero, zero}, saved_im = {zero, zero};
+        __m512i count = _mm512_setzero_si512();
+        __mmask8 cycled = 0;
+        int next_save = 2;
+
+        for (int it = 0; it < max_iterations; ++it) {
+            const __mmask8 active = _mm512_cmp_pd_mask(z_re.hi * z_re.hi + z_im.hi * z_im.hi, four, _CMP_LT_OQ) & ~cycled;
+            if (active == 0) break;
+
+            power_step<P>(z_re, z_im, power, p_re, p_im);
+            const DD next_re = p_re + c_re, next_im = p_im + c_im;
+            z_re = {_mm512_mask_mov_pd(z_re.hi, active, next_re.hi), _mm512_mask_mov_pd(z_re.lo, active, next_re.lo)};
+            z_im = {_mm512_mask_mov_pd(z_im.hi, active, next_im.hi), _mm512_mask_mov_pd(z_im.lo, active, next_im.lo)};
+            count = _mm512_mask_add_epi64(count, active, count, one);
+
+            if (check_period) {
+                const Double8 d_re = (z_re - saved_re).hi, d_im = (z_im - saved_im).hi;
+                cycled |= _mm512_mask_cmp_pd_mask(active, d_re * d_re + d_im * d_im, tolerance2, _CMP_LT_OQ);
+                if (it + 1 == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        int64_t lanes[8];
+        _mm512_storeu_si512(lanes, count);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = (cycled >> l & 1) ? max_iterations : int(lanes[l]);
+            periodic += cycled >> l & 1;
+        }
+    }
+    return periodic;
+}
+
+#endif
+
+// The single-precision kernels: the same iteration in floats, whose vectors hold twice as many
+// lanes. They take the points in doubles like the other kernels and round them to floats, so they
+// are only exact enough for shallow views and small numbers of iterations.
+
+template <int P>
+static int escape_time_float_scalar(const EscapeParams& params, const double *cr, const double *ci, int n, int *counts,
+                                    double *zr, double *zi, float *smooth) {
+    return escape_time_scalar<P, float>(params, cr, ci, n, counts, zr, zi, smooth);
+}
+
+#ifdef KERNELS_X86
+
+// Rounds `used` points to floats, the unused lanes repeating the last point as in pad_tail.
+static inline void pad_tail_float(const double *values, int used, int lanes, float *tail) {
+    for (int l = 0; l < lanes; ++l) tail[l] = values[std::min(l, used - 1)];
+}
+
+template <int P>
+__attribute__((target("avx2")))
+static int escape_time_float_avx2(const EscapeParams& params, const double *cr, const double *ci, int n, int *counts,
+                                  double *zr, double *zi, float *smooth) {
+    const int power = params.power, max_iterations = params.max_iterations;
+    if (P == 0 && power < 1) return escape_time_float_scalar<0>(params, cr, ci, n, counts, zr, zi, smooth);
+    const bool check_period = params.period_tolerance > 0;
+    const __m256 four = _mm256_set1_ps(4.f), tolerance2 = _mm256_set1_ps(params.period_tolerance * params.period_tolerance);
+    const __m256i limit = _mm256_set1_epi32(max_iterations);
+    int periodic = 0;
+
+    for (int j = 0; j < n; j += 8) {
+        const int used = std::min(8, n - j);
+        float tail_re[8], tail_im[8];
+        pad_tail_float(cr + j, used, 8, tail_re);
+        pad_tail_float(ci + j, used, 8, tail_im);
+        const __m256 c_re = _mm256_loadu_ps(tail_re), c_im = _mm256_loadu_ps(tail_im);
+        __m256 z_re = _mm256_setzero_ps(), z_im = _mm256_setzero_ps(), p_re, p_im;
+        __m256i count = _mm256_setzero_si256();
+        if (zr) {
+            float tail_z_re[8], tail_z_im[8];
+            int tail_count[8];
+            pad_tail_float(zr + j, used, 8, tail_z_re);
+            pad_tail_float(zi + j, used, 8, tail_z_im);
+            z_re = _mm256_loadu_ps(tail_z_re);
+            z_im = _mm256_loadu_ps(tail_z_im);
+            count = _mm256_loadu_si256((const __m256i *)pad_tail(counts + j, used, 8, tail_count));
+        }
+        __m256 saved_re = z_re, saved_im = z_im, cycled = _mm256_setzero_ps();
+        int next_save = 2;
+
+        for (int it = 0; it < max_iterations; ++it) {
+            const __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(z_re, z_re), _mm256_mul_ps(z_im, z_im)), four, _CMP_LT_OQ);
+            __m256 active = _mm256_andnot_ps(cycled, inside);
+            if (zr) active = _mm256_and_ps(active, _mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, count)));
+            if (_mm256_movemask_ps(active) == 0) break;
+
+            power_step<P>(z_re, z_im, power, p_re, p_im);
+            z_re = _mm256_blendv_ps(z_re, _mm256_add_ps(p_re, c_re), active);
+            z_im = _mm256_blendv_ps(z_im, _mm256_add_ps(p_im, c_im), active);
+            count = _mm256_sub_epi32(count, _mm256_castps_si256(active));
+
+            if (check_period) {
+                const __m256 d_re = _mm256_sub_ps(z_re, saved_re), d_im = _mm256_sub_ps(z_im, saved_im);
+                const __m256 close = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(d_re, d_re), _mm256_mul_ps(d_im, d_im)), tolerance2, _CMP_LT_OQ);
+                cycled = _mm256_or_ps(cycled, _mm256_and_ps(active, close));
+                if (it + 1 == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        int32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, count);
+        const int cycled_lanes = _mm256_movemask_ps(cycled);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = (cycled_lanes >> l & 1) ? max_iterations : lanes[l];
+            periodic += cycled_lanes >> l & 1;
+        }
+        if (smooth)
+            store_smooth(_mm256_add_ps(_mm256_mul_ps(z_re, z_re), _mm256_mul_ps(z_im, z_im)), counts + j, used, max_iterations,
+                         float(inverse_log2(power)), smooth + j);
+        if (zr) {
+            float last_re[8], last_im[8];
+            _mm256_storeu_ps(last_re, z_re);
+            _mm256_storeu_ps(last_im, z_im);
+            std::copy(last_re, last_re + used, zr + j);
+            std::copy(last_im, last_im + used, zi + j);
+        }
+    }
+    return periodic;
+}
+
+template <int P>
+__attribute__((target("avx512f")))
+static int escape_time_float_avx512(const EscapeParams& params, const double *cr, const double *ci, int n, int *counts,
+                                    double *zr, double *zi, float *smooth) {
+    const int power = params.power, max_iterations = params.max_iterations;
+    if (P == 0 && power < 1) return escape_time_float_scalar<0>(params, cr, ci, n, counts, zr, zi, smooth);
+    const bool check_period = params.period_tolerance > 0;
+    const __m512 four = _mm512_set1_ps(4.f), tolerance2 = _mm512_set1_ps(params.period_tolerance * params.period_tolerance);
+    const __m512i one = _mm512_set1_epi32(1), limit = _mm512_set1_epi32(max_iterations);
+    int periodic = 0;
+
+    for (int j = 0; j < n; j += 16) {
+        const int used = std::min(16, n - j);
+        float tail_re[16], tail_im[16];
+        pad_tail_float(cr + j, used, 16, tail_re);
+        pad_tail_float(ci + j, used, 16, tail_im);
+        const __m512 c_re = _mm512_loadu_ps(tail_re), c_im = _mm512_loadu_ps(tail_im);
+        __m512 z_re = _mm512_setzero_ps(), z_im = _mm512_setzero_ps(), p_re, p_im;
+        __m512i count = _mm512_setzero_si512();
+        if (zr) {
+            float tail_z_re[16], tail_z_im[16];
+            int tail_count[16];
+            pad_tail_float(zr + j, used, 16, tail_z_re);
+            pad_tail_float(zi + j, used, 16, tail_z_im);
+            z_re = _mm512_loadu_ps(tail_z_re);
+            z_im = _mm512_loadu_ps(tail_z_im);
+            count = _mm512_loadu_si512(pad_tail(counts + j, used, 16, tail_count));
+        }
+        __m512 saved_re = z_re, saved_im = z_im;
+        __mmask16 cycled = 0;
+        int next_save = 2;
+
+        for (int it = 0; it < max_iterations; ++it) {
+            __mmask16 active = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(z_re, z_re), _mm512_mul_ps(z_im, z_im)), four, _CMP_LT_OQ) & ~cycled;
+            if (zr) active &= _mm512_cmplt_epi32_mask(count, limit);
+            if (active == 0) break;
+
+            power_step<P>(z_re, z_im, power, p_re, p_im);
+            z_re = _mm512_mask_add_ps(z_re, active, p_re, c_re);
+            z_im = _mm512_mask_add_ps(z_im, active, p_im, c_im);
+            count = _mm512_mask_add_epi32(count, active, count, one);
+
+            if (check_period) {
+                const __m512 d_re = _mm512_sub_ps(z_re, saved_re), d_im = _mm512_sub_ps(z_im, saved_im);
+                cycled |= _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(_mm512_mul_ps(d_re, d_re), _mm512_mul_ps(d_im, d_im)), tolerance2, _CMP_LT_OQ);
+                if (it + 1 == next_save) {
+                    saved_re = z_re;
+                    saved_im = z_im;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        int32_t lanes[16];
+        _mm512_storeu_si512(lanes, count);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = (cycled >> l & 1) ? max_iterations : lanes[l];
+            periodic += cycled >> l & 1;
+        }
+        if (smooth)
+            store_smooth(_mm512_add_ps(_mm512_mul_ps(z_re, z_re), _mm512_mul_ps(z_im, z_im)), counts + j, used, max_iterations,
+                         float(inverse_log2(power)), smooth + j);
+        if (zr) {
+            float last_re[16], last_im[16];
+            _mm512_storeu_ps(last_re, z_re);
+            _mm512_storeu_ps(last_im, z_im);
+            std::copy(last_re, last_re + used, zr + j);
+            std::copy(last_im, last_im + used, zi + j);
+        }
+    }
+    return periodic;
+}
+
+#endif
+
+// The instantiations of a kernel, indexed by power; index 0 is the general version.
+#define POWER_KERNELS(kernel) { kernel<0>, kernel<1>, kernel<2>, kernel<3>, kernel<4>, kernel<5>, kernel<6>, kernel<7>, kernel<8> }
+static const int SPECIALIZED_POWERS = 8;
+
+KernelType detect_kernel() {
+#ifdef KERNELS_X86
+    if (__builtin_cpu_supports("avx512f")) return KernelType::AVX512;
+    if (__builtin_cpu_supports("avx2")) return KernelType::AVX2;
+#endif
+    return KernelType::Scalar;
+}
+
+bool kernel_supported(KernelType type) {
+    switch (type) {
+#ifdef KERNELS_X86
+        case KernelType::AVX512: return __builtin_cpu_supports("avx512f");
+        case KernelType::AVX2: return __builtin_cpu_supports("avx2");
+#endif
+        case KernelType::Scalar: return true;
+        default: return false;
+    }
+}
+
+EscapeKernel get_kernel(KernelType type, int power) {
+    static const EscapeKernel scalar[] = POWER_KERNELS(escape_time_scalar);
+#ifdef KERNELS_X86
+    static const EscapeKernel avx2[] = POWER_KERNELS(escape_time_avx2);
+    static const EscapeKernel avx512[] = POWER_KERNELS(escape_time_avx512);
+#endif
+    const int index = (power >= 1 && power <= SPECIALIZED_POWERS) ? power : 0;
+
+    switch (type) {
+#ifdef KERNELS_X86
+        case KernelType::AVX512: return avx512[index];
+        case KernelType::AVX2: return avx2[index];
+#endif
+        default: return scalar[index];
+    }
+}
+
+EscapeKernel get_float_kernel(KernelType type, int power) {
+    static const EscapeKernel scalar[] = POWER_KERNELS(escape_time_float_scalar);
+#ifdef KERNELS_X86
+    static const EscapeKernel avx2[] = POWER_KERNELS(escape_time_float_avx2);
+    static const EscapeKernel avx512[] = POWER_KERNELS(escape_time_float_avx512);
+#endif
+    const int index = (power >= 1 && power <= SPECIALIZED_POWERS) ? power : 0;
+
+    switch (type) {
+#ifdef KERNELS_X86
+        case KernelType::AVX512: return avx512[index];
+        case KernelType::AVX2: return avx2[index];
+#endif
+        default: return scalar[index];
+    }
+}
+
+DoubleDoubleKernel get_double_double_kernel(KernelType type, int power) {
+    static const DoubleDoubleKernel scalar[] = POWER_KERNELS(escape_time_double_double_scalar);
+#ifdef KERNELS_X86
+    static const DoubleDoubleKernel avx2[] = POWER_KERNELS(escape_time_double_double_avx2);
+    static const DoubleDoubleKernel avx512[] = POWER_KERNELS(escape_time_double_double_avx512);
+#endif
+    const int index = (power >= 1 && power <= SPECIALIZED_POWERS) ? power : 0;
+
+    switch (type) {
+#ifdef KERNELS_X86
+        case KernelType::AVX512: return avx512[index];
+        case KernelType::AVX2: return avx2[index];
+#endif
+        default: return scalar[index];
+    }
+}
+
+const char *kernel_name(KernelType type) {
+    switch (type) {
+        case KernelType::AVX512: return "avx512";
+        case KernelType::AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+bool parse_kernel(const char *name, KernelType& type) {
+    for (KernelType t : {KernelType::Scalar, KernelType::AVX2, KernelType::AVX512}) {
+        if (strcmp(name, kernel_name(t)) == 0) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
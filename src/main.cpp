@@ -3,18 +3,64 @@
 #include "fractales.hpp"
 #include "ez-draw++.hpp"
 #include <cstring>
+#include <algorithm>
 
 int main(int argc, char **argv) {
 
-    int power = 2, max_iterations = 30; // Default values
+    int power = 2, max_iterations = 30, pixel_step = 16; // Default values
+    RenderSettings settings;
 
-    if (argc > 1) { // If there are arguments, we change the default values
-        if (argc > 2 && strcmp(argv[1],"-p") == 0) power = std::atoi(argv[2]);
-        if (argc > 3 && strcmp(argv[3], "-i") == 0) max_iterations = std::atoi(argv[4]);
+    // If there are arguments, we change the default values
+    for (int arg = 1; arg < argc; arg += 2) {
+        if (strcmp(argv[arg], "-v") == 0) {
+            settings.verify = true; // The only option without a value
+            --arg;
+            continue;
+        }
+        if (arg + 1 >= argc) break;
+
+        if (strcmp(argv[arg], "-p") == 0) power = std::atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-i") == 0) max_iterations = std::atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-s") == 0) pixel_step = std::atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-t") == 0) settings.threads = std::atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-e") == 0) settings.period_tolerance = std::atof(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-g") == 0) settings.guess.block = std::max(std::atoi(argv[arg + 1]), 1);
+        else if (strcmp(argv[arg], "-u") == 0) settings.guess.audit = std::max(std::atoi(argv[arg + 1]), 0);
+        else if (strcmp(argv[arg], "-A") == 0) settings.antialias = std::max(std::atof(argv[arg + 1]), 0.);
+        else if (strcmp(argv[arg], "-k") == 0) {
+            if (!parse_kernel(argv[arg + 1], settings.kernel)) {
+                std::cerr << "Unknown kernel " << argv[arg + 1] << " (scalar, avx2 or avx512)" << std::endl;
+                return 1;
+            }
+            if (!kernel_supported(settings.kernel)) {
+                std::cerr << "This processor can't run the " << argv[arg + 1] << " kernel" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-a") == 0) {
+            if (!parse_arithmetic(argv[arg + 1], settings.arithmetic)) {
+                std::cerr << "Unknown arithmetic " << argv[arg + 1] << " (auto, float, double, double-double or perturbation)" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-c") == 0) {
+            if (!parse_palette(argv[arg + 1], settings.palette)) {
+                std::cerr << "Unknown palette " << argv[arg + 1] << " (bands, gradient or grey)" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-m") == 0) {
+            if (!parse_mode(argv[arg + 1], settings.mode)) {
+                std::cerr << "Unknown render mode " << argv[arg + 1] << " (brute, mariani, boundary or guess)" << std::endl;
+                return 1;
+            }
+        }
     }
+    std::cout << "Kernel: " << kernel_name(settings.kernel) << ", render mode: " << mode_name(settings.mode)
+              << ", arithmetic: " << arithmetic_name(settings.arithmetic) << ", palette: " << palette_name(settings.palette) << std::endl;
 
     // We create the application and execute it
-    App myApp(power, max_iterations);
+    App myApp(power, max_iterations, std::max(pixel_step, 1), settings);
     myApp.mainLoop();
 
     return 0;
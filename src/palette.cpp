@@ -0,0 +1,127 @@
+#include "../include/palette.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+// The gradient goes through these colours every GRADIENT_PERIOD counts, and back to the first.
+const int GRADIENT_PERIOD = 64;
+const EZuint8 GRADIENT_COLORS[][3] = {{0, 7, 100}, {32, 107, 203}, {237, 255, 255}, {255, 170, 0}, {0, 2, 0}};
+const int GRADIENT_SIZE = sizeof GRADIENT_COLORS / sizeof GRADIENT_COLORS[0];
+// The batches of rows a colouring is split in, a few per core.
+const int COLORIZE_JOBS = 64;
+
+const char *palette_name(Palette palette) {
+    switch (palette) {
+        case Palette::Gradient: return "gradient";
+        case Palette::Grey: return "grey";
+        default: return "bands";
+    }
+}
+
+bool parse_palette(const char *name, Palette& palette) {
+    for (Palette p : {Palette::Bands, Palette::Gradient, Palette::Grey}) {
+        if (strcmp(name, palette_name(p)) == 0) {
+            palette = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+Palette next_palette(Palette palette) {
+    switch (palette) {
+        case Palette::Bands: return Palette::Gradient;
+        case Palette::Gradient: return Palette::Grey;
+        default: return Palette::Bands;
+    }
+}
+
+Colorizer::Colorizer(Palette _palette, int _max_iterations)
+    : palette(_palette), max_iterations(std::max(_max_iterations, 1)), table(max_iterations + 1)
+{
+    for (int count = 0; count <= max_iterations; ++count) {
+        EZuint8 color[4] = {0, 0, 0, 255}; // Inside, black whatever the palette
+        if (count >= max_iterations) {
+            std::memcpy(&table[count], color, 4);
+            continue;
+        }
+
+        switch (palette) {
+            case Palette::Gradient: {
+                const double position = double(count % GRADIENT_PERIOD) / GRADIENT_PERIOD * GRADIENT_SIZE;
+                const int from = int(position), to = (from + 1) % GRADIENT_SIZE;
+                const double t = position - from;
+                for (int c = 0; c < 3; ++c)
+                    color[c] = EZuint8(std::lround((1 - t) * GRADIENT_COLORS[from][c] + t * GRADIENT_COLORS[to][c]));
+                break;
+            }
+            case Palette::Grey:
+                color[0] = color[1] = color[2] = EZuint8(std::lround(255 * std::log1p(count) / std::log1p(max_iterations)));
+                break;
+            default: {
+                const EZColor& band = count > max_iterations / 2 ? EZColor::cyan : EZColor::blue;
+                color[0] = band.getRed();
+                color[1] = band.getGreen();
+                color[2] = band.getBlue();
+                break;
+            }
+        }
+        std::memcpy(&table[count], color, 4);
+    }
+}
+
+// (256 - t) a + t b over 256 for the four bytes of the colours at once, two of them in each
+// half of a 32-bit product.
+static inline uint32_t blend(uint32_t a, uint32_t b, uint32_t t) {
+    const uint32_t even = ((a & 0xff00ff) * (256 - t) + (b & 0xff00ff) * t) >> 8 & 0xff00ff;
+    const uint32_t odd = ((a >> 8 & 0xff00ff) * (256 - t) + (b >> 8 & 0xff00ff) * t) & 0xff00ff00;
+    return even | odd;
+}
+
+void Colorizer::colorize_rows(const int *counts, const float *smooth, int width, int step, int first, int last,
+                              EZuint8 *rgba) const {
+    const uint32_t *colors = table.data();
+    for (int k = first; k < last; ++k) {
+        const int source = (k - k % step) * width;
+        EZuint8 *out = &rgba[size_t(k) * width * 4];
+        for (int i = 0; i < width; i += step) {
+            const int n = source + i, count = counts[n];
+            uint32_t color = colors[count];
+            // The fraction of an iteration blends the colour with the one of the next count, in 256ths
+            if (smooth && count < max_iterations) color = blend(color, colors[count + 1], uint32_t(smooth[n] * 256));
+            if (step == 1) std::memcpy(&out[4 * i], &color, 4);
+            else for (int j = i; j < std::min(i + step, width); ++j) std::memcpy(&out[4 * j], &color, 4);
+        }
+    }
+}
+
+void Colorizer::colorize(const int *counts, const float *smooth, int width, int height, int step, EZuint8 *rgba,
+                         RenderPool *pool) const {
+    if (!pool) {
+        colorize_rows(counts, smooth, width, step, 0, height, rgba);
+        return;
+    }
+    const int rows = (height + COLORIZE_JOBS - 1) / COLORIZE_JOBS;
+    pool->run(COLORIZE_JOBS, [&](size_t job) {
+        colorize_rows(counts, smooth, width, step, std::min(int(job) * rows, height), std::min(int(job + 1) * rows, height), rgba);
+    });
+}
+
+void Colorizer::supersample(const int *pixels, const int *counts, const float *smooth, int n, int per_pixel,
+                            EZuint8 *rgba) const {
+    const int samples = per_pixel + 1;
+    for (int k = 0; k < n; ++k) {
+        EZuint8 *const out = &rgba[size_t(pixels[k]) * 4];
+        int sum[3] = {out[0], out[1], out[2]};
+        for (int m = 0; m < per_pixel; ++m) {
+            const int count = counts[k * per_pixel + m];
+            uint32_t blended = table[count];
+            if (smooth && count < max_iterations) blended = blend(blended, table[count + 1], uint32_t(smooth[k * per_pixel + m] * 256));
+            EZuint8 color[4];
+            std::memcpy(color, &blended, 4);
+            for (int c = 0; c < 3; ++c) sum[c] += color[c];
+        }
+        for (int c = 0; c < 3; ++c) out[c] = EZuint8((sum[c] + samples / 2) / samples);
+    }
+}
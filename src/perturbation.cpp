@@ -0,0 +1,899 @@
+#include "../include/perturbation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PERTURBATION_X86
+#endif
+
+// The most reference orbits computed for one image. The pixels still glitched after that keep the
+// counts of their rebased iteration.
+const size_t MAX_REFERENCES = 16;
+// Pixels smaller than this are iterated with deltas scaled by an exponent while the deltas are still
+// too small for doubles, i.e. below 2^DOUBLE_DELTA_EXPONENT. Past it, the doubles keep the 53 bits of dz and
+// of its growth, and dc, then far smaller, can be rounded to a double.
+const double DOUBLE_DELTA_LIMIT = 1e-290;
+const int DOUBLE_DELTA_EXPONENT = -900;
+// How far the scaled deltas grow before they get a new exponent.
+const int RESCALE_EXPONENT = 64;
+// A step is valid while the powers of dz it leaves out are below this fraction of dz, as small as
+// the rounding of doubles.
+const double STEP_TOLERANCE = 0x1p-53;
+
+const char *arithmetic_name(Arithmetic arithmetic) {
+    switch (arithmetic) {
+        case Arithmetic::Float: return "float";
+        case Arithmetic::Double: return "double";
+        case Arithmetic::DoubleDouble: return "double-double";
+        case Arithmetic::Perturbation: return "perturbation";
+        default: return "auto";
+    }
+}
+
+bool parse_arithmetic(const char *name, Arithmetic& arithmetic) {
+    for (Arithmetic a : {Arithmetic::Auto, Arithmetic::Float, Arithmetic::Double, Arithmetic::DoubleDouble,
+                          Arithmetic::Perturbation}) {
+        if (strcmp(name, arithmetic_name(a)) == 0) {
+            arithmetic = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+double DeepView::relative_spacing() const {
+    // The orbits go through values of magnitude 1 whatever the view, hence the floor
+    const double center_re = double(re(height / 2)), center_im = double(im(width / 2));
+    return double(std::min(xscale, yscale) / std::max({std::fabs(center_re), std::fabs(center_im), 1.}));
+}
+
+Arithmetic choose_arithmetic(const DeepView& view, const EscapeParams& params) {
+    const double spacing = view.relative_spacing();
+    if (spacing >= FLOAT_PRECISION_LIMIT && params.max_iterations <= FLOAT_MAX_ITERATIONS) return Arithmetic::Float;
+    if (spacing >= DOUBLE_PRECISION_LIMIT) return Arithmetic::Double;
+    return spacing >= DOUBLE_DOUBLE_PRECISION_LIMIT ? Arithmetic::DoubleDouble : Arithmetic::Perturbation;
+}
+
+// (re + i im)^2, with three squares: the imaginary part 2 re im is (re + im)^2 - re^2 - im^2.
+static void complex_square(Precise& re, Precise& im) {
+    const Precise r2 = square(re), i2 = square(im), s2 = square(re + im);
+    re = r2 - i2;
+    im = s2 - r2 - i2;
+}
+
+ReferenceOrbit::ReferenceOrbit(const DeepView& view, const EscapeParams& params, int _x, int _y)
+    : x(_x), y(_y)
+{
+    const Precise cr = view.re(y), ci = view.im(x);
+    Precise zr = 0, zi = 0;
+    re.push_back(0);
+    im.push_back(0);
+
+    // The bits of the power, from the highest one
+    int high_bit = 0;
+    while (params.power >> (high_bit + 1)) ++high_bit;
+
+    for (int n = 0; n < params.max_iterations; ++n) {
+        if (params.power == 2) {
+            complex_square(zr, zi);
+        } else if (params.power < 1) {
+            zr = 1;
+            zi = 0;
+        } else {
+            // z^power by squaring
+            Precise pr = zr, pi = zi;
+            for (int bit = high_bit - 1; bit >= 0; --bit) {
+                complex_square(pr, pi);
+                if (params.power >> bit & 1) {
+                    const Precise t = pr * zr - pi * zi;
+                    pi = pr * zi + pi * zr;
+                    pr = t;
+                }
+            }
+            zr = pr;
+            zi = pi;
+        }
+        zr = zr + cr;
+        zi = zi + ci;
+
+        re.push_back(double(zr));
+        im.push_back(double(zi));
+        if (re.back() * re.back() + im.back() * im.back() >= 4) break;
+    }
+
+    // The single iterations from the index m: dz' = power Z^(power - 1) dz + dc, and the powers of dz
+    // left out are at most (power - 1) |dz| / |Z| of it. They are merged in pairs level by level.
+    if (params.power < 1) return;
+    const int last = length() - 1;
+    const FloatExp far_re = std::max(y, view.height - y) * view.xscale, far_im = std::max(x, view.width - x) * view.yscale;
+    const double max_dc = std::hypot(double(far_re), double(far_im)); // The largest |dc| of the view
+    std::vector<BilinearStep> level;
+    for (int m = 1; m + 1 < last; ++m) {
+        double ar = 1, ai = 0;
+        for (int k = 1; k < params.power; ++k) {
+            const double t = ar * re[m] - ai * im[m];
+            ai = ar * im[m] + ai * re[m];
+            ar = t;
+        }
+        const double radius = params.power == 1 ? INFINITY : STEP_TOLERANCE * std::hypot(re[m], im[m]) / (params.power - 1);
+        level.push_back({params.power * ar, params.power * ai, 1, 0, radius});
+    }
+
+    // s then t: dz'' = At (As dz + Bs dc) + Bt dc, valid if dz is, and if the dz' it gives is
+    while (level.size() >= 2) {
+        std::vector<BilinearStep> merged(level.size() / 2);
+        for (size_t i = 0; i < merged.size(); ++i) {
+            const BilinearStep &s = level[2 * i], &t = level[2 * i + 1];
+            const double as = std::hypot(s.a_re, s.a_im), bs = std::hypot(s.b_re, s.b_im);
+            merged[i] = {t.a_re * s.a_re - t.a_im * s.a_im, t.a_re * s.a_im + t.a_im * s.a_re,
+                         t.a_re * s.b_re - t.a_im * s.b_im + t.b_re, t.a_re * s.b_im + t.a_im * s.b_re + t.b_im,
+                         std::min(s.radius, std::max(0., (t.radius - bs * max_dc) / as))};
+        }
+        level = merged;
+        steps.push_back(std::move(merged));
+    }
+}
+
+Perturbation::Perturbation(const DeepView& _view, const EscapeParams& _params, KernelType _type)
+    : view(_view), params(_params), type(_type)
+{
+    binomial.push_back(1);
+    for (int k = 1; k <= params.power; ++k) binomial.push_back(binomial.back() * (params.power - k + 1) / k);
+    references.push_back(std::make_unique<ReferenceOrbit>(view, params, view.width / 2, view.height / 2));
+}
+
+// The longest step of the reference that starts at the index m > 0, is valid for a dz of squared
+// norm dz2 and has at most left iterations, or nullptr. dz may be given divided by a scale, which
+// multiplies the radii by radius_scale; growth then bounds |A| and |B| so that the scaled dz stays
+// within the doubles.
+static inline const BilinearStep *find_step(const ReferenceOrbit& reference, int m, int left, double dz2, int& length,
+                                            double radius_scale = 1, double growth = INFINITY) {
+    const std::vector<std::vector<BilinearStep>>& steps = reference.steps;
+    const double growth2 = growth * growth;
+    // The radii only shrink from a level to the next, whose steps start at every other index
+    const BilinearStep *step = nullptr;
+    for (size_t k = 0; k < steps.size(); ++k) {
+        const int l = 2 << k;
+        if ((m - 1) % l != 0 || l > left || size_t((m - 1) / l) >= steps[k].size()) break;
+        const BilinearStep& s = steps[k][(m - 1) / l];
+        const double radius = s.radius * radius_scale;
+        if (!(dz2 < radius * radius)) break;
+        if (!(std::max(s.a_re * s.a_re + s.a_im * s.a_im, s.b_re * s.b_re + s.b_im * s.b_im) < growth2)) break;
+        step = &s;
+        length = l;
+    }
+    return step;
+}
+
+// Moves dz forward with the longest step valid for it, and adds its length to m, count and skipped.
+// dz and dc are scaled alike, as in find_step. Returns false if there is no such step.
+static inline bool skip(const ReferenceOrbit& reference, int& m, int& count, int max_iterations, double& dzr, double& dzi,
+                        double dcr, double dci, long& skipped, double radius_scale = 1, double growth = INFINITY) {
+    int length;
+    const BilinearStep *step = m == 0 ? nullptr : find_step(reference, m, max_iterations - count, dzr * dzr + dzi * dzi,
+                                                            length, radius_scale, growth);
+    if (!step) return false;
+
+    const double t = step->a_re * dzr - step->a_im * dzi + step->b_re * dcr - step->b_im * dci;
+    dzi = step->a_re * dzi + step->a_im * dzr + step->b_re * dci + step->b_im * dcr;
+    dzr = t;
+    m += length;
+    count += length;
+    skipped += length;
+    return true;
+}
+
+// The iteration of the perturbation, with (Z + dz)^power - Z^power = s dz and the factor s written
+// out by a functor, so that the loop of the power 2 has no branch on the power. It goes on from the
+// iteration count, at the index m of the reference orbit, with the delta dz.
+template <class Factor>
+static inline int perturbed_count(const ReferenceOrbit& reference, const EscapeParams& params, double dcr, double dci,
+                                  bool& glitch, long& skipped, const Factor& factor, int count = 0, int m = 0,
+                                  double dzr = 0, double dzi = 0) {
+    const double *Zr = reference.re.data(), *Zi = reference.im.data();
+    const int last = reference.length() - 1, max_iterations = params.max_iterations;
+
+    while (count < max_iterations) {
+        if (skip(reference, m, count, max_iterations, dzr, dzi, dcr, dci, skipped)) continue;
+        double sr, si;
+        factor(Zr[m], Zi[m], dzr, dzi, sr, si);
+        const double t = sr * dzr - si * dzi + dcr;
+        dzi = sr * dzi + si * dzr + dci;
+        dzr = t;
+        ++m;
+        ++count;
+
+        const double zr = Zr[m] + dzr, zi = Zi[m] + dzi, z2 = zr * zr + zi * zi;
+        if (z2 >= 4) break;
+        if (z2 < dzr * dzr + dzi * dzi || m == last) {
+            // Past the end of an escaped reference, the pixel can only go on from the start of the
+            // orbit with dz = z, where its offset dc is lost in the rounding of z
+            if (m == last && count < max_iterations) glitch = true;
+            dzr = zr;
+            dzi = zi;
+            m = 0;
+        }
+    }
+    return count;
+}
+
+// s = 2 Z + dz.
+struct SquareFactor {
+    inline void operator()(double Zr, double Zi, double dzr, double dzi, double& sr, double& si) const {
+        sr = 2 * Zr + dzr;
+        si = 2 * Zi + dzi;
+    }
+};
+
+// s is the sum of the C(power, k) Z^k dz^(power - 1 - k) for k < power, evaluated by Horner's rule
+// in dz. At the powers below 1, z^power = 1 whatever z, and s = 0.
+struct PowerFactor {
+    int power;
+    const double *binomial;
+
+    inline void operator()(double Zr, double Zi, double dzr, double dzi, double& sr, double& si) const {
+        if (power < 1) {
+            sr = si = 0;
+            return;
+        }
+        sr = 1;
+        si = 0;
+        double wr = Zr, wi = Zi; // w = Z^k
+        for (int k = 1; k < power; ++k) {
+            const double t = sr * dzr - si * dzi + binomial[k] * wr;
+            si = sr * dzi + si * dzr + binomial[k] * wi;
+            sr = t;
+            const double u = wr * Zr - wi * Zi;
+            wi = wr * Zi + wi * Zr;
+            wr = u;
+        }
+    }
+};
+
+// The pixels smaller than doubles, without the cost of a FloatExp per operation: dz and dc share
+// one exponent S, dz = dzs 2^S and dc = dcs 2^S, and the iteration becomes dzs' = s dzs + dcs, in
+// doubles, with s from dz = dzs 2^S. Where 2^S underflows, dz is 0 in s, which it is next to the
+// terms of Z anyway. The exponent only changes when dzs has grown past 2^RESCALE_EXPONENT, and once
+// 2^S is large enough for doubles, the iteration goes on with the deltas themselves.
+template <class Factor>
+static int rescaled_count(const ReferenceOrbit& reference, const EscapeParams& params, const FloatExp& dcr,
+                          const FloatExp& dci, bool& glitch, long& skipped, const Factor& factor) {
+    const double *Zr = reference.re.data(), *Zi = reference.im.data();
+    const int last = reference.length() - 1, max_iterations = params.max_iterations;
+    // The steps may make dzs grow by up to 2^-DOUBLE_DELTA_EXPONENT before it is scaled again
+    const double growth = std::ldexp(1., -DOUBLE_DELTA_EXPONENT);
+
+    int exponent = std::max(dcr.get_exponent(), dci.get_exponent());
+    double scale = double(FloatExp(1., exponent)), inverse_scale = double(FloatExp(1., -exponent));
+    double dcsr = double(dcr * FloatExp(1., -exponent)), dcsi = double(dci * FloatExp(1., -exponent));
+    double dzr = 0, dzi = 0;
+    int m = 0, count = 0;
+    while (count < max_iterations) {
+        if (!skip(reference, m, count, max_iterations, dzr, dzi, dcsr, dcsi, skipped, inverse_scale, growth)) {
+            double sr, si;
+            factor(Zr[m], Zi[m], dzr * scale, dzi * scale, sr, si);
+            const double t = sr * dzr - si * dzi;
+            dzi = sr * dzi + si * dzr + dcsi;
+            dzr = t + dcsr;
+            ++m;
+            ++count;
+
+            const double zr = Zr[m] + dzr * scale, zi = Zi[m] + dzi * scale, z2 = zr * zr + zi * zi;
+            if (z2 >= 4) return count;
+            // z is Z here, a tiny dz can only be larger than it at the nucleus of a minibrot
+            const double dz2 = (dzr * dzr + dzi * dzi) * scale * scale;
+            if (z2 < dz2 || m == last) {
+                if (m == last && count < max_iterations) glitch = true;
+                return perturbed_count(reference, params, double(dcr), double(dci), glitch, skipped, factor, count, 0, zr, zi);
+            }
+        }
+
+        const double size = std::max(std::fabs(dzr), std::fabs(dzi));
+        if (size >= std::ldexp(1., RESCALE_EXPONENT)) {
+            const int shift = FloatExp(size).get_exponent();
+            exponent += shift;
+            if (exponent >= DOUBLE_DELTA_EXPONENT) {
+                return perturbed_count(reference, params, double(dcr), double(dci), glitch, skipped, factor, count, m,
+                                       double(FloatExp(dzr, exponent - shift)), double(FloatExp(dzi, exponent - shift)));
+            }
+            const double scaling = std::ldexp(1., -shift);
+            dzr *= scaling;
+            dzi *= scaling;
+            dcsr *= scaling;
+            dcsi *= scaling;
+            scale = double(FloatExp(1., exponent));
+            inverse_scale = double(FloatExp(1., -exponent));
+        }
+    }
+    return count;
+}
+
+// Delta is double, or FloatExp for the pixels too small for doubles.
+template <typename Delta>
+static void perturbed_scalar(const ReferenceOrbit& reference, const EscapeParams& params, const double *binomial,
+                             const Delta *dcr, const Delta *dci, int n, int *counts, bool *glitches, long& skipped) {
+    auto count = [&](int j, const auto& factor) {
+        if constexpr (std::is_same_v<Delta, FloatExp>)
+            return rescaled_count(reference, params, dcr[j], dci[j], glitches[j], skipped, factor);
+        else
+            return perturbed_count(reference, params, dcr[j], dci[j], glitches[j], skipped, factor);
+    };
+    for (int j = 0; j < n; ++j) {
+        glitches[j] = false;
+        if (params.power == 2) counts[j] = count(j, SquareFactor());
+        else counts[j] = count(j, PowerFactor{params.power, binomial});
+    }
+}
+
+#ifdef PERTURBATION_X86
+
+// The vector versions of the power 2, which do the same operations as the scalar one in the lanes
+// of a register. Every lane has its own index in the reference orbit, since the pixels are rebased
+// at different times, so Z is gathered, unless all the lanes are at the same index, which is common
+// and spares the gather. Only then can they take a step, the one valid for all of them: it can be
+// shorter than the scalar one, so the counts may differ where the steps round differently. As in
+// the escape-time kernels, the lanes whose pixel escaped are masked and the unused lanes of the
+// last vector repeat its last pixel.
+
+static inline const double *pad_tail(const double *values, int used, int lanes, double *tail) {
+    if (used == lanes) return values;
+    for (int l = 0; l < lanes; ++l) tail[l] = values[std::min(l, used - 1)];
+    return tail;
+}
+
+// The iterations of a vector of pixels of offsets dc in doubles, from the iteration start, where the
+// active lanes are all at the index start of the reference with the deltas dz. Their counts go on
+// from count, and glitched gets their glitches.
+__attribute__((target("avx2")))
+static inline void iterate_avx2(const ReferenceOrbit& reference, const EscapeParams& params, const __m256d& dc_re,
+                                const __m256d& dc_im, __m256d dz_re, __m256d dz_im, __m256d active, int start, int used,
+                                __m256i& count, __m256d& glitched, long& skipped) {
+    const double *Zr = reference.re.data(), *Zi = reference.im.data();
+    const __m256d four = _mm256_set1_pd(4.);
+    const __m256i last = _mm256_set1_epi64x(reference.length() - 1);
+    __m256d Z_re = _mm256_set1_pd(Zr[start]), Z_im = _mm256_set1_pd(Zi[start]);
+    __m256i m = _mm256_set1_epi64x(start);
+
+    for (int it = start; it < params.max_iterations && _mm256_movemask_pd(active); ++it) {
+        // The active lanes at one index take a step together, valid for the largest of their dz
+        const int active_lanes = _mm256_movemask_pd(active);
+        const int64_t m_first = m[__builtin_ctz(active_lanes)];
+        const int same = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(m, _mm256_set1_epi64x(m_first))));
+        if (m_first > 0 && (same & active_lanes) == active_lanes) {
+            double dz2[4];
+            _mm256_storeu_pd(dz2, _mm256_and_pd(active, _mm256_add_pd(_mm256_mul_pd(dz_re, dz_re), _mm256_mul_pd(dz_im, dz_im))));
+            int length;
+            if (const BilinearStep *step = find_step(reference, m_first, params.max_iterations - it,
+                                                     std::max({dz2[0], dz2[1], dz2[2], dz2[3]}), length)) {
+                const __m256d a_re = _mm256_set1_pd(step->a_re), a_im = _mm256_set1_pd(step->a_im);
+                const __m256d b_re = _mm256_set1_pd(step->b_re), b_im = _mm256_set1_pd(step->b_im);
+                const __m256d t = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(a_re, dz_re), _mm256_mul_pd(a_im, dz_im)),
+                                                _mm256_sub_pd(_mm256_mul_pd(b_re, dc_re), _mm256_mul_pd(b_im, dc_im)));
+                const __m256d new_im = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a_re, dz_im), _mm256_mul_pd(a_im, dz_re)),
+                                                     _mm256_add_pd(_mm256_mul_pd(b_re, dc_im), _mm256_mul_pd(b_im, dc_re)));
+                dz_re = _mm256_blendv_pd(dz_re, t, active);
+                dz_im = _mm256_blendv_pd(dz_im, new_im, active);
+                const __m256i steps = _mm256_and_si256(_mm256_castpd_si256(active), _mm256_set1_epi64x(length));
+                m = _mm256_add_epi64(m, steps);
+                count = _mm256_add_epi64(count, steps);
+                Z_re = _mm256_set1_pd(Zr[m_first + length]);
+                Z_im = _mm256_set1_pd(Zi[m_first + length]);
+                skipped += long(length) * __builtin_popcount(active_lanes & ((1 << used) - 1));
+                it += length - 1;
+                continue;
+            }
+        }
+
+        // Z at the next index is loaded first, it only depends on m
+        m = _mm256_sub_epi64(m, _mm256_castpd_si256(active)); // An active lane is all ones, i.e. -1
+        count = _mm256_sub_epi64(count, _mm256_castpd_si256(active));
+        const int64_t m0 = m[0];
+        __m256d next_re, next_im;
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(m, _mm256_set1_epi64x(m0)))) == 0xf) {
+            next_re = _mm256_set1_pd(Zr[m0]);
+            next_im = _mm256_set1_pd(Zi[m0]);
+        }
+        else {
+            next_re = _mm256_i64gather_pd(Zr, m, 8);
+            next_im = _mm256_i64gather_pd(Zi, m, 8);
+        }
+
+        const __m256d a_re = _mm256_add_pd(_mm256_add_pd(Z_re, Z_re), dz_re), a_im = _mm256_add_pd(_mm256_add_pd(Z_im, Z_im), dz_im);
+        const __m256d t = _mm256_sub_pd(_mm256_mul_pd(a_re, dz_re), _mm256_mul_pd(a_im, dz_im));
+        const __m256d new_im = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a_re, dz_im), _mm256_mul_pd(a_im, dz_re)), dc_im);
+        dz_re = _mm256_blendv_pd(dz_re, _mm256_add_pd(t, dc_re), active);
+        dz_im = _mm256_blendv_pd(dz_im, new_im, active);
+
+        const __m256d z_re = _mm256_add_pd(next_re, dz_re), z_im = _mm256_add_pd(next_im, dz_im);
+        const __m256d z2 = _mm256_add_pd(_mm256_mul_pd(z_re, z_re), _mm256_mul_pd(z_im, z_im));
+        active = _mm256_and_pd(active, _mm256_cmp_pd(z2, four, _CMP_LT_OQ));
+
+        // A rebased lane starts again from Z_0 = 0
+        const __m256d at_end = _mm256_castsi256_pd(_mm256_cmpeq_epi64(m, last));
+        const __m256d closer = _mm256_cmp_pd(z2, _mm256_add_pd(_mm256_mul_pd(dz_re, dz_re), _mm256_mul_pd(dz_im, dz_im)), _CMP_LT_OQ);
+        const __m256d rebase = _mm256_and_pd(active, _mm256_or_pd(closer, at_end));
+        if (it + 1 < params.max_iterations) glitched = _mm256_or_pd(glitched, _mm256_and_pd(active, at_end));
+        dz_re = _mm256_blendv_pd(dz_re, z_re, rebase);
+        dz_im = _mm256_blendv_pd(dz_im, z_im, rebase);
+        Z_re = _mm256_andnot_pd(rebase, next_re);
+        Z_im = _mm256_andnot_pd(rebase, next_im);
+        m = _mm256_andnot_si256(_mm256_castpd_si256(rebase), m);
+    }
+
+}
+
+__attribute__((target("avx2")))
+static void perturbed_avx2(const ReferenceOrbit& reference, const EscapeParams& params,
+                           const double *dcr, const double *dci, int n, int *counts, bool *glitches,
+                           long& skipped) {
+    for (int j = 0; j < n; j += 4) {
+        const int used = std::min(4, n - j);
+        double tail_re[4], tail_im[4];
+        const __m256d dc_re = _mm256_loadu_pd(pad_tail(dcr + j, used, 4, tail_re)), dc_im = _mm256_loadu_pd(pad_tail(dci + j, used, 4, tail_im));
+        __m256i count = _mm256_setzero_si256();
+        __m256d glitched = _mm256_setzero_pd();
+        iterate_avx2(reference, params, dc_re, dc_im, _mm256_setzero_pd(), _mm256_setzero_pd(),
+                     _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 0, used, count, glitched, skipped);
+
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, count);
+        const int glitched_lanes = _mm256_movemask_pd(glitched);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = lanes[l];
+            glitches[j + l] = glitched_lanes >> l & 1;
+        }
+    }
+}
+
+// The pixels smaller than doubles, iterated as rescaled_count() does in the lanes of a register.
+// The lanes share the exponent of their largest dc: their deltas grow alike, multiplied by the same
+// Z, and stay within a few powers of two of one another. The lanes then stay at the same index of
+// the reference, so Z needs no gather and the steps are the ones valid for all of them. A lane that
+// rebases leaves the vector and goes on alone in doubles. Once the exponent is large enough for
+// doubles, the lanes left go on with their deltas in the loop of the double deltas.
+__attribute__((target("avx2")))
+static void scaled_avx2(const ReferenceOrbit& reference, const EscapeParams& params, const FloatExp *dcr, const FloatExp *dci,
+                        int n, int *counts, bool *glitches, long& skipped) {
+    const double *Zr = reference.re.data(), *Zi = reference.im.data();
+    const int last = reference.length() - 1, max_iterations = params.max_iterations;
+    const double growth = std::ldexp(1., -DOUBLE_DELTA_EXPONENT);
+    const __m256d four = _mm256_set1_pd(4.), limit = _mm256_set1_pd(std::ldexp(1., RESCALE_EXPONENT)), sign = _mm256_set1_pd(-0.);
+
+    for (int j = 0; j < n; j += 4) {
+        const int used = std::min(4, n - j);
+        int exponent = FloatExp::ZERO_EXPONENT;
+        for (int l = 0; l < used; ++l) exponent = std::max({exponent, dcr[j + l].get_exponent(), dci[j + l].get_exponent()});
+        double dcs_re[4], dcs_im[4];
+        for (int l = 0; l < 4; ++l) {
+            const int k = j + std::min(l, used - 1);
+            dcs_re[l] = double(dcr[k] * FloatExp(1., -exponent));
+            dcs_im[l] = double(dci[k] * FloatExp(1., -exponent));
+        }
+        __m256d dc_re = _mm256_loadu_pd(dcs_re), dc_im = _mm256_loadu_pd(dcs_im);
+        double scale = double(FloatExp(1., exponent)), inverse_scale = double(FloatExp(1., -exponent));
+        __m256d dz_re = _mm256_setzero_pd(), dz_im = _mm256_setzero_pd(), active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        __m256i count = _mm256_setzero_si256();
+        double rebase_re[4], rebase_im[4]; // The z the rebased lanes go on from
+        int rebased = 0, glitched_lanes = 0;
+        bool in_doubles = false;
+
+        // it is also the index of all the lanes in the reference
+        int it = 0;
+        while (it < max_iterations && _mm256_movemask_pd(active)) {
+            const int active_lanes = _mm256_movemask_pd(active);
+            const BilinearStep *step = nullptr;
+            int length = 0;
+            if (it > 0) {
+                double dz2[4];
+                _mm256_storeu_pd(dz2, _mm256_and_pd(active, _mm256_add_pd(_mm256_mul_pd(dz_re, dz_re), _mm256_mul_pd(dz_im, dz_im))));
+                step = find_step(reference, it, max_iterations - it, std::max({dz2[0], dz2[1], dz2[2], dz2[3]}), length,
+                                 inverse_scale, growth);
+            }
+            if (step) {
+                const __m256d a_re = _mm256_set1_pd(step->a_re), a_im = _mm256_set1_pd(step->a_im);
+                const __m256d b_re = _mm256_set1_pd(step->b_re), b_im = _mm256_set1_pd(step->b_im);
+                const __m256d t = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(a_re, dz_re), _mm256_mul_pd(a_im, dz_im)),
+                                                _mm256_sub_pd(_mm256_mul_pd(b_re, dc_re), _mm256_mul_pd(b_im, dc_im)));
+                const __m256d new_im = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a_re, dz_im), _mm256_mul_pd(a_im, dz_re)),
+                                                     _mm256_add_pd(_mm256_mul_pd(b_re, dc_im), _mm256_mul_pd(b_im, dc_re)));
+                dz_re = _mm256_blendv_pd(dz_re, t, active);
+                dz_im = _mm256_blendv_pd(dz_im, new_im, active);
+                it += length;
+                count = _mm256_blendv_epi8(count, _mm256_set1_epi64x(it), _mm256_castpd_si256(active));
+                skipped += long(length) * __builtin_popcount(active_lanes & ((1 << used) - 1));
+            }
+            else {
+                const __m256d scale_v = _mm256_set1_pd(scale);
+                const __m256d a_re = _mm256_add_pd(_mm256_set1_pd(2 * Zr[it]), _mm256_mul_pd(dz_re, scale_v));
+                const __m256d a_im = _mm256_add_pd(_mm256_set1_pd(2 * Zi[it]), _mm256_mul_pd(dz_im, scale_v));
+                const __m256d t = _mm256_sub_pd(_mm256_mul_pd(a_re, dz_re), _mm256_mul_pd(a_im, dz_im));
+                const __m256d new_im = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a_re, dz_im), _mm256_mul_pd(a_im, dz_re)), dc_im);
+                dz_re = _mm256_blendv_pd(dz_re, _mm256_add_pd(t, dc_re), active);
+                dz_im = _mm256_blendv_pd(dz_im, new_im, active);
+                ++it;
+                count = _mm256_blendv_epi8(count, _mm256_set1_epi64x(it), _mm256_castpd_si256(active));
+
+                const __m256d z_re = _mm256_add_pd(_mm256_set1_pd(Zr[it]), _mm256_mul_pd(dz_re, scale_v));
+                const __m256d z_im = _mm256_add_pd(_mm256_set1_pd(Zi[it]), _mm256_mul_pd(dz_im, scale_v));
+                const __m256d z2 = _mm256_add_pd(_mm256_mul_pd(z_re, z_re), _mm256_mul_pd(z_im, z_im));
+                active = _mm256_and_pd(active, _mm256_cmp_pd(z2, four, _CMP_LT_OQ));
+                // z is Z here, a tiny dz can only be larger than it at the nucleus of a minibrot
+                const __m256d dz2 = _mm256_mul_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(dz_re, dz_re), _mm256_mul_pd(dz_im, dz_im)),
+                                                                scale_v), scale_v);
+                const __m256d rebase = it == last ? active : _mm256_and_pd(active, _mm256_cmp_pd(z2, dz2, _CMP_LT_OQ));
+                if (const int rebase_lanes = _mm256_movemask_pd(rebase)) {
+                    double last_re[4], last_im[4];
+                    _mm256_storeu_pd(last_re, z_re);
+                    _mm256_storeu_pd(last_im, z_im);
+                    for (int l = 0; l < 4; ++l) {
+                        if (!(rebase_lanes >> l & 1)) continue;
+                        rebase_re[l] = last_re[l];
+                        rebase_im[l] = last_im[l];
+                    }
+                    rebased |= rebase_lanes;
+                    if (it == last && it < max_iterations) glitched_lanes |= rebase_lanes;
+                    active = _mm256_andnot_pd(rebase, active);
+                }
+            }
+
+            const __m256d large = _mm256_or_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, dz_re), limit, _CMP_GE_OQ),
+                                               _mm256_cmp_pd(_mm256_andnot_pd(sign, dz_im), limit, _CMP_GE_OQ));
+            if (_mm256_movemask_pd(_mm256_and_pd(large, active))) {
+                double size[4];
+                _mm256_storeu_pd(size, _mm256_and_pd(active, _mm256_max_pd(_mm256_andnot_pd(sign, dz_re), _mm256_andnot_pd(sign, dz_im))));
+                const int shift = FloatExp(std::max({size[0], size[1], size[2], size[3]})).get_exponent();
+                const __m256d scaling = _mm256_set1_pd(std::ldexp(1., -shift));
+                exponent += shift;
+                dz_re = _mm256_mul_pd(dz_re, scaling);
+                dz_im = _mm256_mul_pd(dz_im, scaling);
+                if (exponent >= DOUBLE_DELTA_EXPONENT) {
+                    in_doubles = true;
+                    break;
+                }
+                dc_re = _mm256_mul_pd(dc_re, scaling);
+                dc_im = _mm256_mul_pd(dc_im, scaling);
+                scale = double(FloatExp(1., exponent));
+                inverse_scale = double(FloatExp(1., -exponent));
+            }
+        }
+
+        __m256d glitched = _mm256_setzero_pd();
+        if (in_doubles) {
+            double tail_re[4], tail_im[4];
+            for (int l = 0; l < 4; ++l) {
+                tail_re[l] = double(dcr[j + std::min(l, used - 1)]);
+                tail_im[l] = double(dci[j + std::min(l, used - 1)]);
+            }
+            const __m256d unscale = _mm256_set1_pd(double(FloatExp(1., exponent)));
+            iterate_avx2(reference, params, _mm256_loadu_pd(tail_re), _mm256_loadu_pd(tail_im), _mm256_mul_pd(dz_re, unscale),
+                         _mm256_mul_pd(dz_im, unscale), active, it, used, count, glitched, skipped);
+        }
+        glitched_lanes |= _mm256_movemask_pd(glitched);
+
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, count);
+        for (int l = 0; l < used; ++l) {
+            bool glitch = glitched_lanes >> l & 1;
+            counts[j + l] = rebased >> l & 1 ? perturbed_count(reference, params, double(dcr[j + l]), double(dci[j + l]), glitch, skipped,
+                                                               SquareFactor(), int(lanes[l]), 0, rebase_re[l], rebase_im[l])
+                                             : int(lanes[l]);
+            glitches[j + l] = glitch;
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static inline void iterate_avx512(const ReferenceOrbit& reference, const EscapeParams& params, const __m512d& dc_re,
+                                  const __m512d& dc_im, __m512d dz_re, __m512d dz_im, __mmask8 active, int start, int used,
+                                  __m512i& count, __mmask8& glitched, long& skipped) {
+    const double *Zr = reference.re.data(), *Zi = reference.im.data();
+    const __m512d four = _mm512_set1_pd(4.);
+    const __m512i last = _mm512_set1_epi64(reference.length() - 1), one = _mm512_set1_epi64(1);
+    __m512d Z_re = _mm512_set1_pd(Zr[start]), Z_im = _mm512_set1_pd(Zi[start]);
+    __m512i m = _mm512_set1_epi64(start);
+
+    for (int it = start; it < params.max_iterations && active; ++it) {
+        // The active lanes at one index take a step together, valid for the largest of their dz
+        const int64_t m_first = m[__builtin_ctz(active)];
+        if (m_first > 0 && _mm512_mask_cmpneq_epi64_mask(active, m, _mm512_set1_epi64(m_first)) == 0) {
+            double dz2[8];
+            _mm512_storeu_pd(dz2, _mm512_maskz_mov_pd(active, _mm512_add_pd(_mm512_mul_pd(dz_re, dz_re), _mm512_mul_pd(dz_im, dz_im))));
+            int length;
+            if (const BilinearStep *step = find_step(reference, m_first, params.max_iterations - it,
+                                                     *std::max_element(dz2, dz2 + 8), length)) {
+                const __m512d a_re = _mm512_set1_pd(step->a_re), a_im = _mm512_set1_pd(step->a_im);
+                const __m512d b_re = _mm512_set1_pd(step->b_re), b_im = _mm512_set1_pd(step->b_im);
+                const __m512d t = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(a_re, dz_re), _mm512_mul_pd(a_im, dz_im)),
+                                                _mm512_sub_pd(_mm512_mul_pd(b_re, dc_re), _mm512_mul_pd(b_im, dc_im)));
+                const __m512d new_im = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(a_re, dz_im), _mm512_mul_pd(a_im, dz_re)),
+                                                     _mm512_add_pd(_mm512_mul_pd(b_re, dc_im), _mm512_mul_pd(b_im, dc_re)));
+                dz_re = _mm512_mask_mov_pd(dz_re, active, t);
+                dz_im = _mm512_mask_mov_pd(dz_im, active, new_im);
+                m = _mm512_mask_add_epi64(m, active, m, _mm512_set1_epi64(length));
+                count = _mm512_mask_add_epi64(count, active, count, _mm512_set1_epi64(length));
+                Z_re = _mm512_set1_pd(Zr[m_first + length]);
+                Z_im = _mm512_set1_pd(Zi[m_first + length]);
+                skipped += long(length) * __builtin_popcount(active & ((1 << used) - 1));
+                it += length - 1;
+                continue;
+            }
+        }
+
+        // Z at the next index is loaded first, it only depends on m
+        m = _mm512_mask_add_epi64(m, active, m, one);
+        count = _mm512_mask_add_epi64(count, active, count, one);
+        const int64_t m0 = m[0];
+        __m512d next_re, next_im;
+        if (_mm512_cmpneq_epi64_mask(m, _mm512_set1_epi64(m0)) == 0) {
+            next_re = _mm512_set1_pd(Zr[m0]);
+            next_im = _mm512_set1_pd(Zi[m0]);
+        }
+        else {
+            next_re = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xff, m, Zr, 8);
+            next_im = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xff, m, Zi, 8);
+        }
+
+        const __m512d a_re = _mm512_add_pd(_mm512_add_pd(Z_re, Z_re), dz_re), a_im = _mm512_add_pd(_mm512_add_pd(Z_im, Z_im), dz_im);
+        const __m512d t = _mm512_sub_pd(_mm512_mul_pd(a_re, dz_re), _mm512_mul_pd(a_im, dz_im));
+        const __m512d new_im = _mm512_add_pd(_mm512_mul_pd(a_re, dz_im), _mm512_mul_pd(a_im, dz_re));
+        dz_re = _mm512_mask_add_pd(dz_re, active, t, dc_re);
+        dz_im = _mm512_mask_add_pd(dz_im, active, new_im, dc_im);
+
+        const __m512d z_re = _mm512_add_pd(next_re, dz_re), z_im = _mm512_add_pd(next_im, dz_im);
+        const __m512d z2 = _mm512_add_pd(_mm512_mul_pd(z_re, z_re), _mm512_mul_pd(z_im, z_im));
+        active = _mm512_mask_cmp_pd_mask(active, z2, four, _CMP_LT_OQ);
+
+        // A rebased lane starts again from Z_0 = 0
+        const __mmask8 at_end = _mm512_mask_cmpeq_epi64_mask(active, m, last);
+        const __mmask8 rebase = _mm512_mask_cmp_pd_mask(active, z2, _mm512_add_pd(_mm512_mul_pd(dz_re, dz_re), _mm512_mul_pd(dz_im, dz_im)), _CMP_LT_OQ) | at_end;
+        if (it + 1 < params.max_iterations) glitched |= at_end;
+        dz_re = _mm512_mask_mov_pd(dz_re, rebase, z_re);
+        dz_im = _mm512_mask_mov_pd(dz_im, rebase, z_im);
+        Z_re = _mm512_maskz_mov_pd(~rebase, next_re);
+        Z_im = _mm512_maskz_mov_pd(~rebase, next_im);
+        m = _mm512_maskz_mov_epi64(~rebase, m);
+    }
+
+}
+
+__attribute__((target("avx512f")))
+static void perturbed_avx512(const ReferenceOrbit& reference, const EscapeParams& params,
+                             const double *dcr, const double *dci, int n, int *counts, bool *glitches,
+                             long& skipped) {
+    for (int j = 0; j < n; j += 8) {
+        const int used = std::min(8, n - j);
+        double tail_re[8], tail_im[8];
+        const __m512d dc_re = _mm512_loadu_pd(pad_tail(dcr + j, used, 8, tail_re)), dc_im = _mm512_loadu_pd(pad_tail(dci + j, used, 8, tail_im));
+        __m512i count = _mm512_setzero_si512();
+        __mmask8 glitched = 0;
+        iterate_avx512(reference, params, dc_re, dc_im, _mm512_setzero_pd(), _mm512_setzero_pd(), 0xff, 0, used, count, glitched, skipped);
+
+        int64_t lanes[8];
+        _mm512_storeu_si512(lanes, count);
+        for (int l = 0; l < used; ++l) {
+            counts[j + l] = lanes[l];
+            glitches[j + l] = glitched >> l & 1;
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void scaled_avx512(const ReferenceOrbit& reference, const EscapeParams& params, const FloatExp *dcr, const FloatExp *dci,
+                          int n, int *counts, bool *glitches, long& skipped) {
+    const double *Zr = reference.re.data(), *Zi = reference.im.data();
+    const int last = reference.length() - 1, max_iterations = params.max_iterations;
+    const double growth = std::ldexp(1., -DOUBLE_DELTA_EXPONENT);
+    const __m512d four = _mm512_set1_pd(4.), limit = _mm512_set1_pd(std::ldexp(1., RESCALE_EXPONENT));
+
+    for (int j = 0; j < n; j += 8) {
+        const int used = std::min(8, n - j);
+        int exponent = FloatExp::ZERO_EXPONENT;
+        for (int l = 0; l < used; ++l) exponent = std::max({exponent, dcr[j + l].get_exponent(), dci[j + l].get_exponent()});
+        double dcs_re[8], dcs_im[8];
+        for (int l = 0; l < 8; ++l) {
+            const int k = j + std::min(l, used - 1);
+            dcs_re[l] = double(dcr[k] * FloatExp(1., -exponent));
+            dcs_im[l] = double(dci[k] * FloatExp(1., -exponent));
+        }
+        __m512d dc_re = _mm512_loadu_pd(dcs_re), dc_im = _mm512_loadu_pd(dcs_im);
+        double scale = double(FloatExp(1., exponent)), inverse_scale = double(FloatExp(1., -exponent));
+        __m512d dz_re = _mm512_setzero_pd(), dz_im = _mm512_setzero_pd();
+        __m512i count = _mm512_setzero_si512();
+        __mmask8 active = 0xff, rebased = 0, glitched = 0;
+        double rebase_re[8], rebase_im[8]; // The z the rebased lanes go on from
+        bool in_doubles = false;
+
+        // it is also the index of all the lanes in the reference
+        int it = 0;
+        while (it < max_iterations && active) {
+            const BilinearStep *step = nullptr;
+            int length = 0;
+            if (it > 0) {
+                double dz2[8];
+                _mm512_storeu_pd(dz2, _mm512_maskz_mov_pd(active, _mm512_add_pd(_mm512_mul_pd(dz_re, dz_re), _mm512_mul_pd(dz_im, dz_im))));
+                step = find_step(reference, it, max_iterations - it, *std::max_element(dz2, dz2 + 8), length, inverse_scale, growth);
+            }
+            if (step) {
+                const __m512d a_re = _mm512_set1_pd(step->a_re), a_im = _mm512_set1_pd(step->a_im);
+                const __m512d b_re = _mm512_set1_pd(step->b_re), b_im = _mm512_set1_pd(step->b_im);
+                const __m512d t = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(a_re, dz_re), _mm512_mul_pd(a_im, dz_im)),
+                                                _mm512_sub_pd(_mm512_mul_pd(b_re, dc_re), _mm512_mul_pd(b_im, dc_im)));
+                const __m512d new_im = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(a_re, dz_im), _mm512_mul_pd(a_im, dz_re)),
+                                                     _mm512_add_pd(_mm512_mul_pd(b_re, dc_im), _mm512_mul_pd(b_im, dc_re)));
+                dz_re = _mm512_mask_mov_pd(dz_re, active, t);
+                dz_im = _mm512_mask_mov_pd(dz_im, active, new_im);
+                it += length;
+                count = _mm512_mask_mov_epi64(count, active, _mm512_set1_epi64(it));
+                skipped += long(length) * __builtin_popcount(active & ((1 << used) - 1));
+            }
+            else {
+                const __m512d scale_v = _mm512_set1_pd(scale);
+                const __m512d a_re = _mm512_add_pd(_mm512_set1_pd(2 * Zr[it]), _mm512_mul_pd(dz_re, scale_v));
+                const __m512d a_im = _mm512_add_pd(_mm512_set1_pd(2 * Zi[it]), _mm512_mul_pd(dz_im, scale_v));
+                const __m512d t = _mm512_sub_pd(_mm512_mul_pd(a_re, dz_re), _mm512_mul_pd(a_im, dz_im));
+                const __m512d new_im = _mm512_add_pd(_mm512_mul_pd(a_re, dz_im), _mm512_mul_pd(a_im, dz_re));
+                dz_re = _mm512_mask_add_pd(dz_re, active, t, dc_re);
+                dz_im = _mm512_mask_add_pd(dz_im, active, new_im, dc_im);
+                ++it;
+                count = _mm512_mask_mov_epi64(count, active, _mm512_set1_epi64(it));
+
+                const __m512d z_re = _mm512_add_pd(_mm512_set1_pd(Zr[it]), _mm512_mul_pd(dz_re, scale_v));
+                const __m512d z_im = _mm512_add_pd(_mm512_set1_pd(Zi[it]), _mm512_mul_pd(dz_im, scale_v));
+                const __m512d z2 = _mm512_add_pd(_mm512_mul_pd(z_re, z_re), _mm512_mul_pd(z_im, z_im));
+                active = _mm512_mask_cmp_pd_mask(active, z2, four, _CMP_LT_OQ);
+                // z is Z here, a tiny dz can only be larger than it at the nucleus of a minibrot
+                const __m512d dz2 = _mm512_mul_pd(_mm512_mul_pd(_mm512_add_pd(_mm512_mul_pd(dz_re, dz_re), _mm512_mul_pd(dz_im, dz_im)),
+                                                                scale_v), scale_v);
+                const __mmask8 rebase = it == last ? active : _mm512_mask_cmp_pd_mask(active, z2, dz2, _CMP_LT_OQ);
+                if (rebase) {
+                    _mm512_mask_storeu_pd(rebase_re, rebase, z_re);
+                    _mm512_mask_storeu_pd(rebase_im, rebase, z_im);
+                    rebased |= rebase;
+                    if (it == last && it < max_iterations) glitched |= rebase;
+                    active &= ~rebase;
+                }
+            }
+
+            const __mmask8 large = _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(dz_re), limit, _CMP_GE_OQ) |
+                                   _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(dz_im), limit, _CMP_GE_OQ);
+            if (large) {
+                double size[16];
+                _mm512_storeu_pd(size, _mm512_maskz_mov_pd(active, _mm512_abs_pd(dz_re)));
+                _mm512_storeu_pd(size + 8, _mm512_maskz_mov_pd(active, _mm512_abs_pd(dz_im)));
+                const int shift = FloatExp(*std::max_element(size, size + 16)).get_exponent();
+                const __m512d scaling = _mm512_set1_pd(std::ldexp(1., -shift));
+                exponent += shift;
+                dz_re = _mm512_mul_pd(dz_re, scaling);
+                dz_im = _mm512_mul_pd(dz_im, scaling);
+                if (exponent >= DOUBLE_DELTA_EXPONENT) {
+                    in_doubles = true;
+                    break;
+                }
+                dc_re = _mm512_mul_pd(dc_re, scaling);
+                dc_im = _mm512_mul_pd(dc_im, scaling);
+                scale = double(FloatExp(1., exponent));
+                inverse_scale = double(FloatExp(1., -exponent));
+            }
+        }
+
+        if (in_doubles) {
+            double tail_re[8], tail_im[8];
+            for (int l = 0; l < 8; ++l) {
+                tail_re[l] = double(dcr[j + std::min(l, used - 1)]);
+                tail_im[l] = double(dci[j + std::min(l, used - 1)]);
+            }
+            const __m512d unscale = _mm512_set1_pd(double(FloatExp(1., exponent)));
+            iterate_avx512(reference, params, _mm512_loadu_pd(tail_re), _mm512_loadu_pd(tail_im), _mm512_mul_pd(dz_re, unscale),
+                           _mm512_mul_pd(dz_im, unscale), active, it, used, count, glitched, skipped);
+        }
+
+        int64_t lanes[8];
+        _mm512_storeu_si512(lanes, count);
+        for (int l = 0; l < used; ++l) {
+            bool glitch = glitched >> l & 1;
+            counts[j + l] = rebased >> l & 1 ? perturbed_count(reference, params, double(dcr[j + l]), double(dci[j + l]), glitch, skipped,
+                                                               SquareFactor(), int(lanes[l]), 0, rebase_re[l], rebase_im[l])
+                                             : int(lanes[l]);
+            glitches[j + l] = glitch;
+        }
+    }
+}
+
+#endif
+
+void Perturbation::iterate(const ReferenceOrbit& reference, const int *pixels, int n, int *counts,
+                           std::vector<int>& found) const {
+    double dcr[TILE_SIZE], dci[TILE_SIZE];
+    FloatExp scaled_dcr[TILE_SIZE], scaled_dci[TILE_SIZE];
+    int chunk_counts[TILE_SIZE];
+    bool glitches[TILE_SIZE];
+    long total = 0, skipped_steps = 0;
+    const double xscale = double(view.xscale), yscale = double(view.yscale);
+    const bool scaled = !(std::min(xscale, yscale) >= DOUBLE_DELTA_LIMIT);
+
+    for (int first = 0; first < n; first += TILE_SIZE) {
+        const int chunk = std::min(TILE_SIZE, n - first);
+        for (int m = 0; m < chunk; ++m) {
+            const int x = pixels[first + m] % view.width, y = pixels[first + m] / view.width;
+            if (scaled) {
+                scaled_dcr[m] = double(y - reference.y) * view.xscale;
+                scaled_dci[m] = double(x - reference.x) * view.yscale;
+            }
+            else {
+                dcr[m] = (y - reference.y) * xscale;
+                dci[m] = (x - reference.x) * yscale;
+            }
+        }
+
+        // The vector loops are those of the power 2
+        switch (params.power == 2 ? type : KernelType::Scalar) {
+#ifdef PERTURBATION_X86
+            case KernelType::AVX512:
+                if (scaled) scaled_avx512(reference, params, scaled_dcr, scaled_dci, chunk, chunk_counts, glitches, skipped_steps);
+                else perturbed_avx512(reference, params, dcr, dci, chunk, chunk_counts, glitches, skipped_steps);
+                break;
+            case KernelType::AVX2:
+                if (scaled) scaled_avx2(reference, params, scaled_dcr, scaled_dci, chunk, chunk_counts, glitches, skipped_steps);
+                else perturbed_avx2(reference, params, dcr, dci, chunk, chunk_counts, glitches, skipped_steps);
+                break;
+#endif
+            default:
+                if (scaled) perturbed_scalar(reference, params, binomial.data(), scaled_dcr, scaled_dci, chunk, chunk_counts, glitches, skipped_steps);
+                else perturbed_scalar(reference, params, binomial.data(), dcr, dci, chunk, chunk_counts, glitches, skipped_steps);
+                break;
+        }
+
+        for (int m = 0; m < chunk; ++m) {
+            counts[pixels[first + m]] = chunk_counts[m];
+            total += chunk_counts[m];
+            if (glitches[m]) found.push_back(pixels[first + m]);
+        }
+    }
+    iterations += total;
+    skipped += skipped_steps;
+}
+
+void Perturbation::compute(const int *pixels, int n, int *counts) {
+    std::vector<int> found;
+    iterate(*references[0], pixels, n, counts, found);
+
+    if (found.empty()) return;
+    std::lock_guard<std::mutex> guard(lock);
+    glitched.insert(glitched.end(), found.begin(), found.end());
+}
+
+void Perturbation::fix_glitches(RenderPool& pool, const Sampler& sampler) {
+    const size_t chunk = TILE_SIZE * TILE_SIZE;
+
+    for (size_t r = 1; r < MAX_REFERENCES && !glitched.empty(); ++r) {
+        if (sampler.cancel && *sampler.cancel) break;
+        std::vector<int> pixels;
+        std::swap(pixels, glitched);
+
+        // The references of the earlier passes are tried first. A new one is taken at the glitched
+        // pixel that lasted the longest, which is the likeliest to stay inside.
+        if (r == references.size()) {
+            const int best = *std::max_element(pixels.begin(), pixels.end(),
+                                               [&](int a, int b) { return sampler.counts[a] < sampler.counts[b]; });
+            references.push_back(std::make_unique<ReferenceOrbit>(view, params, best % view.width, best / view.width));
+        }
+        const ReferenceOrbit& reference = *references[r];
+        sampler.stats.glitches += pixels.size();
+
+        pool.run((pixels.size() + chunk - 1) / chunk, [&](size_t job) {
+            std::vector<int> found;
+            const size_t first = job * chunk;
+            iterate(reference, &pixels[first], std::min(chunk, pixels.size() - first), sampler.counts, found);
+
+            if (found.empty()) return;
+            std::lock_guard<std::mutex> guard(lock);
+            glitched.insert(glitched.end(), found.begin(), found.end());
+        });
+    }
+    glitched.clear();
+}
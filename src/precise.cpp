@@ -0,0 +1,180 @@
+#include "../include/precise.hpp"
+#include <algorithm>
+#include <cmath>
+
+typedef unsigned __int128 uint128_t;
+
+// The bits kept below the size of a pixel: the reference orbits lose some at every iteration.
+const int GUARD_BITS = 64;
+
+Precise::Precise(double value, int _limbs)
+    : limbs(std::clamp(_limbs, 1, MAX_LIMBS))
+{
+    // A negative value is negated in two's complement once its magnitude is stored: each step of
+    // splitting a positive value is exact.
+    const double magnitude = std::fabs(value), integer = std::floor(magnitude);
+    double fraction = magnitude - integer;
+    limb[0] = uint64_t(integer);
+    for (int i = 1; i < limbs; ++i) {
+        fraction = std::ldexp(fraction, 64);
+        const double digit = std::floor(fraction);
+        limb[i] = uint64_t(digit);
+        fraction -= digit;
+    }
+    if (value < 0) *this = -*this;
+}
+
+Precise::Precise(const FloatExp& value, int _limbs)
+    : Precise(0, _limbs)
+{
+    if (value.get_exponent() >= -960) {
+        *this = Precise(double(value), _limbs);
+        return;
+    }
+    // The mantissa as an integer of 53 bits, value = bits * 2^shift. Its lowest bit falls in the limb
+    // index, whose own lowest bit weighs 2^(-64 index), at offset bits from it.
+    const uint64_t bits = uint64_t(std::ldexp(std::fabs(value.get_mantissa()), 52));
+    const int shift = value.get_exponent() - 52;
+    const int index = (-shift + 63) / 64, offset = shift + 64 * index;
+    if (index - 1 >= limbs) return; // Below the last limb
+    if (index < limbs) limb[index] = bits << offset;
+    if (offset > 0) limb[index - 1] = bits >> (64 - offset);
+    if (value.get_mantissa() < 0) *this = -*this;
+}
+
+void Precise::set_precision(int _limbs) {
+    _limbs = std::clamp(_limbs, 1, MAX_LIMBS);
+    std::fill(limb + std::min(limbs, _limbs), limb + _limbs, 0);
+    limbs = _limbs;
+}
+
+int Precise::precision_for(const FloatExp& spacing) {
+    if (!(spacing.get_mantissa() > 0)) return MAX_LIMBS;
+    const int bits = int(std::ceil(-spacing.log2())) + GUARD_BITS;
+    return std::clamp(1 + (bits + 63) / 64, int(DEFAULT_LIMBS), int(MAX_LIMBS));
+}
+
+Precise::operator double() const {
+    // In two's complement, a small negative value has a fraction close to 1 that cancels with the
+    // integer part: its bits would be lost in the sum
+    if (negative()) return -double(magnitude());
+    // The small limbs first, so that they are not lost in the rounding of the large ones
+    double value = 0;
+    for (int i = limbs - 1; i >= 1; --i) value += std::ldexp(double(limb[i]), -64 * i);
+    return value + double(int64_t(limb[0]));
+}
+
+Precise::operator FloatExp() const {
+    if (negative()) return -FloatExp(magnitude());
+    // The first limb that is not zero and the next one hold all the bits a double keeps
+    for (int i = 0; i < limbs; ++i) {
+        if (limb[i] == 0) continue;
+        double value = double(limb[i]);
+        if (i + 1 < limbs) value += std::ldexp(double(limb[i + 1]), -64);
+        return FloatExp(value, -64 * i);
+    }
+    return FloatExp();
+}
+
+Precise Precise::operator-() const {
+    Precise r(0, limbs);
+    uint64_t carry = 1; // -a = ~a + 1
+    for (int i = limbs - 1; i >= 0; --i) {
+        r.limb[i] = ~limb[i] + carry;
+        carry = carry && r.limb[i] == 0;
+    }
+    return r;
+}
+
+Precise Precise::magnitude() const {
+    return negative() ? -*this : *this;
+}
+
+Precise operator+(const Precise& a, const Precise& b) {
+    const int n = std::max(a.limbs, b.limbs);
+    Precise r(0, n);
+    uint64_t carry = 0;
+    for (int i = n - 1; i >= 0; --i) {
+        const uint64_t x = i < a.limbs ? a.limb[i] : 0, y = i < b.limbs ? b.limb[i] : 0;
+        const uint128_t sum = uint128_t(x) + y + carry;
+        r.limb[i] = uint64_t(sum);
+        carry = uint64_t(sum >> 64);
+    }
+    return r;
+}
+
+Precise operator-(const Precise& a, const Precise& b) {
+    const int n = std::max(a.limbs, b.limbs);
+    Precise r(0, n);
+    uint64_t borrow = 0;
+    for (int i = n - 1; i >= 0; --i) {
+        const uint64_t x = i < a.limbs ? a.limb[i] : 0, y = i < b.limbs ? b.limb[i] : 0;
+        r.limb[i] = x - y - borrow;
+        borrow = x < y || (x == y && borrow);
+    }
+    return r;
+}
+
+// The products are summed column by column: the products limb[i] * limb[j] with i + j = k have their
+// low half at the place of limb k and their high half at the place of limb k - 1. A column is summed
+// on 192 bits, then its low limb is stored and the sum shifted to become the carry of the next one.
+// The columns past the last limb are dropped, except the first one for its carries.
+static inline void accumulate(uint64_t sum[3], uint128_t product) {
+    const uint128_t low = uint128_t(sum[0]) + uint64_t(product);
+    const uint128_t high = uint128_t(sum[1]) + uint64_t(product >> 64) + uint64_t(low >> 64);
+    sum[0] = uint64_t(low);
+    sum[1] = uint64_t(high);
+    sum[2] += uint64_t(high >> 64);
+}
+
+static inline void next_column(uint64_t sum[3]) {
+    sum[0] = sum[1];
+    sum[1] = sum[2];
+    sum[2] = 0;
+}
+
+Precise operator*(const Precise& a, const Precise& b) {
+    const int n = std::max(a.limbs, b.limbs);
+    Precise x = a.magnitude(), y = b.magnitude(), r(0, n);
+    x.set_precision(n);
+    y.set_precision(n);
+
+    uint64_t sum[3] = {0, 0, 0};
+    for (int k = n; k >= 0; --k) {
+        for (int i = std::max(0, k - n + 1); i <= std::min(k, n - 1); ++i)
+            accumulate(sum, uint128_t(x.limb[i]) * y.limb[k - i]);
+        if (k < n) r.limb[k] = sum[0];
+        next_column(sum);
+    }
+    return a.negative() != b.negative() ? -r : r;
+}
+
+Precise square(const Precise& a) {
+    const int n = a.limbs;
+    const Precise x = a.magnitude();
+    Precise r(0, n);
+
+    uint64_t sum[3] = {0, 0, 0};
+    for (int k = n; k >= 0; --k) {
+        // The products limb[i] * limb[k - i] with i < k - i appear twice in the column: they are
+        // computed once, and their sum doubled
+        uint64_t twice[3] = {0, 0, 0};
+        for (int i = std::max(0, k - n + 1); i < k - i; ++i) accumulate(twice, uint128_t(x.limb[i]) * x.limb[k - i]);
+        const uint128_t low = uint128_t(sum[0]) + (twice[0] << 1);
+        const uint128_t high = uint128_t(sum[1]) + (twice[1] << 1 | twice[0] >> 63) + uint64_t(low >> 64);
+        sum[0] = uint64_t(low);
+        sum[1] = uint64_t(high);
+        sum[2] += (twice[2] << 1 | twice[1] >> 63) + uint64_t(high >> 64);
+
+        if (k % 2 == 0) accumulate(sum, uint128_t(x.limb[k / 2]) * x.limb[k / 2]);
+        if (k < n) r.limb[k] = sum[0];
+        next_column(sum);
+    }
+    return r;
+}
+
+bool operator==(const Precise& a, const Precise& b) {
+    for (int i = 0; i < std::max(a.limbs, b.limbs); ++i)
+        if ((i < a.limbs ? a.limb[i] : 0) != (i < b.limbs ? b.limb[i] : 0)) return false;
+    return true;
+}
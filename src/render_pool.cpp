@@ -0,0 +1,98 @@
+#include "../include/render_pool.hpp"
+#include <chrono>
+
+RenderPool::RenderPool(unsigned threads)
+    : generation(0), stopping(false), current(nullptr), remaining(0), completed(0)
+{
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1; // hardware_concurrency() may not know
+
+    for (unsigned i = 0; i < threads; ++i) queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < threads; ++i) workers.emplace_back(&RenderPool::worker_loop, this, i);
+}
+
+RenderPool::~RenderPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+bool RenderPool::pop(unsigned id, size_t& job) {
+    // We first take the next job of our own slice, in order, to keep neighbouring tiles together
+    {
+        Queue& own = *queues[id];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.jobs.empty()) {
+            job = own.jobs.front();
+            own.jobs.pop_front();
+            return true;
+        }
+    }
+
+    // Otherwise we steal the last job of another worker, the one its owner would reach last
+    for (size_t i = 1; i < queues.size(); ++i) {
+        Queue& victim = *queues[(id + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.back();
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void RenderPool::worker_loop(unsigned id) {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        size_t job;
+        while (pop(id, job)) {
+            // The job is read after the pop: the queue lock orders it after run() published it
+            (*current.load())(job);
+            completed.fetch_add(1);
+            if (remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> guard(lock);
+                finished.notify_all();
+            }
+        }
+    }
+}
+
+void RenderPool::run(size_t count, const std::function<void(size_t)>& job,
+                     const std::function<void(size_t)>& progress) {
+    if (count == 0) return;
+
+    current = &job;
+    completed = 0;
+    remaining = count;
+
+    // Every worker gets a contiguous slice of the batch, the stealing evens out the rest
+    for (size_t w = 0; w < queues.size(); ++w) {
+        Queue& queue = *queues[w];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        for (size_t i = w * count / queues.size(); i < (w + 1) * count / queues.size(); ++i)
+            queue.jobs.push_back(i);
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    ++generation;
+    wake.notify_all();
+    while (!finished.wait_for(guard, std::chrono::milliseconds(50), [&] { return remaining == 0; })) {
+        if (progress) {
+            guard.unlock();
+            progress(completed);
+            guard.lock();
+        }
+    }
+    if (progress) progress(count);
+}
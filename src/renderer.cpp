@@ -0,0 +1,932 @@
+#include "../include/renderer.hpp"
+#include "../include/perturbation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+// Below this size, a rectangle of the Mariani-Silver subdivision is computed pixel by pixel.
+const int MIN_SUBDIVISION = 4;
+// The side of the tiles traced independently by the boundary tracing, in pixels.
+const int BOUNDARY_TILE_SIZE = 100;
+// An axis of symmetry is taken as going through a row or a column of pixels, or between two, when it
+// is this close to it, in pixels.
+const double MIRROR_TOLERANCE = 1e-6;
+// The pixels are taken as square, for the symmetry about the diagonals, when their sides differ by
+// less than this fraction.
+const double SQUARE_TOLERANCE = 1e-9;
+
+const char *mode_name(RenderMode mode) {
+    switch (mode) {
+        case RenderMode::MarianiSilver: return "mariani";
+        case RenderMode::BoundaryTrace: return "boundary";
+        case RenderMode::SolidGuess: return "guess";
+        default: return "brute";
+    }
+}
+
+bool parse_mode(const char *name, RenderMode& mode) {
+    for (RenderMode m : {RenderMode::Brute, RenderMode::MarianiSilver, RenderMode::BoundaryTrace, RenderMode::SolidGuess}) {
+        if (strcmp(name, mode_name(m)) == 0) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RenderStats::print(std::ostream& os) const {
+    os << "  " << pixels << " pixels in " << seconds << " s" << std::endl;
+    if (filled > 0)
+        os << "  " << filled << " pixels (" << 100. * filled / pixels << " %) filled from their surroundings" << std::endl;
+    if (interior_shortcuts > 0)
+        os << "  " << interior_shortcuts << " pixels in the cardioid or the period-2 bulb ("
+           << 100. * interior_shortcuts / pixels << " %), not iterated" << std::endl;
+    if (periodic > 0)
+        os << "  " << periodic << " pixels with a periodic orbit (" << 100. * periodic / pixels
+           << " %), stopped early" << std::endl;
+    if (resumed > 0)
+        os << "  " << resumed << " pixels (" << 100. * resumed / pixels
+           << " %) went on from the previous image, the others kept their counts" << std::endl;
+    if (audited > 0)
+        os << "  " << audited << " guessed pixels computed to check them: " << guess_errors << " ("
+           << 100. * guess_errors / audited << " %) were wrong" << std::endl;
+    if (moved > 0)
+        os << "  " << moved << " pixels moved from the previous image, not computed" << std::endl;
+    if (supersampled > 0)
+        os << "  " << supersampled << " pixels (" << 100. * supersampled / (pixels + mirrored) << " %) on the edges given "
+           << SUBSAMPLES << " more points, " << 100. * supersample_iterations / std::max(iterations.load(), 1L)
+           << " % more iterations" << std::endl;
+    if (mirrored > 0)
+        os << "  " << mirrored << " pixels (" << 100. * mirrored / (pixels + mirrored)
+           << " %) copied from their images by the symmetries of the set, not computed" << std::endl;
+    if (references > 0) {
+        os << "  " << references << " reference orbits of " << reference_bits << " bits, " << glitches << " glitched pixels computed again" << std::endl;
+        os << "  " << 100. * skipped << " % of the iterations skipped by the bilinear approximation" << std::endl;
+    }
+}
+
+// The tolerance of the cycle detection is meant for the pixels of double precision. On deeper views
+// it shrinks with the pixels, or the escaping orbits that linger near a cycle would be taken as
+// periodic.
+static EscapeParams deep_params(EscapeParams params, const DeepView *deep) {
+    if (deep) params.period_tolerance *= std::min(1., deep->relative_spacing() / DOUBLE_PRECISION_LIMIT);
+    return params;
+}
+
+Sampler::Sampler(const View& _view, const EscapeParams& _params, KernelType type, int *_counts, RenderStats& _stats,
+                 const std::atomic<bool> *_cancel, Perturbation *_perturbation, const DeepView *_deep, bool single_precision,
+                 FinalOrbits *_orbits, float *_smooth)
+    : kernel(single_precision ? get_float_kernel(type, _params.power) : get_kernel(type, _params.power)), double_double_kernel(get_double_double_kernel(type, _params.power)),
+      re_hi(0), re_lo(0), im_hi(0), im_lo(0), view(_view), params(deep_params(_params, _deep)), counts(_counts), stats(_stats), cancel(_cancel),
+      perturbation(_perturbation), deep(_deep), orbits(_orbits), smooth(_smooth)
+{
+    if (deep) {
+        re_hi = double(deep->xmin);
+        re_lo = double(deep->xmin - Precise(re_hi, deep->xmin.precision()));
+        im_hi = double(deep->ymin);
+        im_lo = double(deep->ymin - Precise(im_hi, deep->ymin.precision()));
+    }
+}
+
+void Sampler::compute(const int *pixels, int n) const {
+    if (cancel && cancel->load(std::memory_order_relaxed)) return;
+    if (perturbation) {
+        perturbation->compute(pixels, n, counts);
+        return;
+    }
+    if (deep) {
+        compute_double_double(pixels, n);
+        return;
+    }
+
+    double cr[TILE_SIZE], ci[TILE_SIZE], zr[TILE_SIZE], zi[TILE_SIZE];
+    int found[TILE_SIZE], index[TILE_SIZE];
+    float fraction[TILE_SIZE];
+    long shortcuts = 0, periodic = 0, iterations = 0;
+
+    for (int first = 0; first < n; first += TILE_SIZE) {
+        // we calculate the real and imaginary part of the numbers c, based on the pixel location and
+        // zoom and position values. At power 2 the points of the cardioid and of the bulb are known
+        // to stay inside, the others are gathered for the kernel.
+        int points = 0;
+        for (int m = first; m < std::min(first + TILE_SIZE, n); ++m) {
+            const double re = view.re(pixels[m] / view.width), im = view.im(pixels[m] % view.width);
+            if (params.power == 2 && in_cardioid_or_bulb(re, im)) {
+                counts[pixels[m]] = params.max_iterations;
+                if (smooth) smooth[pixels[m]] = 0;
+                ++shortcuts;
+            }
+            else {
+                cr[points] = re;
+                ci[points] = im;
+                if (orbits) {
+                    // A pixel whose last z is known stopped at its count, where it goes on from
+                    const bool known = !std::isnan(orbits->re[pixels[m]]);
+                    zr[points] = known ? orbits->re[pixels[m]] : 0.;
+                    zi[points] = known ? orbits->im[pixels[m]] : 0.;
+                    found[points] = known ? counts[pixels[m]] : 0;
+                }
+                index[points++] = pixels[m];
+            }
+        }
+        // The iterations run, from the count each pixel starts at
+        if (orbits) for (int m = 0; m < points; ++m) iterations -= found[m];
+        periodic += kernel(params, cr, ci, points, found, orbits ? zr : nullptr, orbits ? zi : nullptr,
+                           smooth ? fraction : nullptr);
+        for (int m = 0; m < points; ++m) {
+            counts[index[m]] = found[m];
+            iterations += found[m];
+        }
+        if (smooth)
+            for (int m = 0; m < points; ++m) smooth[index[m]] = fraction[m];
+        if (orbits) {
+            for (int m = 0; m < points; ++m) {
+                orbits->re[index[m]] = zr[m];
+                orbits->im[index[m]] = zi[m];
+            }
+        }
+    }
+
+    if (shortcuts) stats.interior_shortcuts += shortcuts;
+    if (periodic) stats.periodic += periodic;
+    if (iterations) stats.iterations += iterations;
+}
+
+void Sampler::compute_double_double(const int *pixels, int n) const {
+    double cr_hi[TILE_SIZE], cr_lo[TILE_SIZE], ci_hi[TILE_SIZE], ci_lo[TILE_SIZE];
+    int found[TILE_SIZE], index[TILE_SIZE];
+    long shortcuts = 0, periodic = 0;
+
+    for (int first = 0; first < n; first += TILE_SIZE) {
+        // The offsets from the corner are small enough for doubles. The cardioid and the bulb only
+        // need the high parts: the points they would misplace are too close to the border to escape.
+        int points = 0;
+        for (int m = first; m < std::min(first + TILE_SIZE, n); ++m) {
+            double re, re_low, im, im_low;
+            double_double_add(re_hi, re_lo, pixels[m] / view.width * double(deep->xscale), re, re_low);
+            double_double_add(im_hi, im_lo, pixels[m] % view.width * double(deep->yscale), im, im_low);
+            if (params.power == 2 && in_cardioid_or_bulb(re, im)) {
+                counts[pixels[m]] = params.max_iterations;
+                ++shortcuts;
+            }
+            else {
+                cr_hi[points] = re;
+                cr_lo[points] = re_low;
+                ci_hi[points] = im;
+                ci_lo[points] = im_low;
+                index[points++] = pixels[m];
+            }
+        }
+        periodic += double_double_kernel(params, cr_hi, cr_lo, ci_hi, ci_lo, points, found);
+        for (int m = 0; m < points; ++m) counts[index[m]] = found[m];
+    }
+
+    if (shortcuts) stats.interior_shortcuts += shortcuts;
+    if (periodic) stats.periodic += periodic;
+}
+
+void Sampler::sample(const double *re, const double *im, int n, int *found, float *fractions) const {
+    if (cancel && cancel->load(std::memory_order_relaxed)) return;
+    double cr[TILE_SIZE], ci[TILE_SIZE];
+    int counts[TILE_SIZE], index[TILE_SIZE];
+    float fraction[TILE_SIZE];
+    for (int first = 0; first < n; first += TILE_SIZE) {
+        int points = 0;
+        for (int m = first; m < std::min(first + TILE_SIZE, n); ++m) {
+            if (params.power == 2 && in_cardioid_or_bulb(re[m], im[m])) {
+                found[m] = params.max_iterations;
+                if (fractions) fractions[m] = 0;
+                continue;
+            }
+            cr[points] = re[m];
+            ci[points] = im[m];
+            index[points++] = m;
+        }
+        kernel(params, cr, ci, points, counts, nullptr, nullptr, fractions ? fraction : nullptr);
+        for (int m = 0; m < points; ++m) found[index[m]] = counts[m];
+        if (fractions)
+            for (int m = 0; m < points; ++m) fractions[index[m]] = fraction[m];
+    }
+}
+
+void Sampler::span(int x, int y, int dx, int dy, int n) const {
+    int pixels[TILE_SIZE];
+    for (int first = 0; first < n; first += TILE_SIZE) {
+        const int chunk = std::min(TILE_SIZE, n - first);
+        for (int m = 0; m < chunk; ++m) pixels[m] = (y + (first + m) * dy) * view.width + x + (first + m) * dx;
+        compute(pixels, chunk);
+    }
+}
+
+// Mariani-Silver: the escape-time levels of the set are connected, so when the whole border of a
+// rectangle has one count, its inside has it too. A rectangle whose border is known has its inside
+// either filled, or split in four by a cross whose pixels become the borders of the four parts.
+// The rectangles of a tile are processed level by level, so that all the pixels a level needs go
+// through the kernel together instead of in short runs that would leave most vector lanes idle.
+struct Rectangle {
+    int x0, y0, x1, y1; // Corners included
+};
+
+// Gives the pixels strictly between first and last, two computed pixels of a row with the same
+// count, fractions of an iteration going linearly from one's to the other's, so that the smooth
+// colouring shows no flat patch where the pixels were filled.
+static void interpolate_smooth(float *smooth, int first, int last) {
+    const float a = smooth[first], b = smooth[last];
+    for (int k = first + 1; k < last; ++k) smooth[k] = a + (b - a) * (k - first) / (last - first);
+}
+
+static void mariani_silver(const Sampler& sampler, const Rectangle& tile) {
+    std::vector<Rectangle> current, next;
+    std::vector<int> batch;
+    auto add = [&](int x, int y) { batch.push_back(y * sampler.view.width + x); };
+
+    // The border of the tile. The tiles do not share their borders, so they stay independent.
+    for (int x = tile.x0; x <= tile.x1; ++x) {
+        add(x, tile.y0);
+        if (tile.y1 > tile.y0) add(x, tile.y1);
+    }
+    for (int y = tile.y0 + 1; y < tile.y1; ++y) {
+        add(tile.x0, y);
+        if (tile.x1 > tile.x0) add(tile.x1, y);
+    }
+    sampler.compute(batch.data(), batch.size());
+    current.push_back(tile);
+
+    while (!current.empty()) {
+        batch.clear();
+        next.clear();
+        for (const Rectangle& r : current) {
+            if (r.x1 - r.x0 < 2 || r.y1 - r.y0 < 2) continue; // No inside
+
+            const int value = sampler.at(r.x0, r.y0);
+            bool uniform = true;
+            for (int x = r.x0; x <= r.x1 && uniform; ++x)
+                uniform = sampler.at(x, r.y0) == value && sampler.at(x, r.y1) == value;
+            for (int y = r.y0 + 1; y < r.y1 && uniform; ++y)
+                uniform = sampler.at(r.x0, y) == value && sampler.at(r.x1, y) == value;
+
+            if (uniform) {
+                for (int y = r.y0 + 1; y < r.y1; ++y)
+                    std::fill(&sampler.at(r.x0 + 1, y), &sampler.at(r.x1, y), value);
+                if (sampler.smooth)
+                    for (int y = r.y0 + 1; y < r.y1; ++y)
+                        interpolate_smooth(sampler.smooth, y * sampler.view.width + r.x0, y * sampler.view.width + r.x1);
+                sampler.stats.filled += long(r.x1 - r.x0 - 1) * (r.y1 - r.y0 - 1);
+            }
+            else if (r.x1 - r.x0 <= MIN_SUBDIVISION || r.y1 - r.y0 <= MIN_SUBDIVISION) {
+                for (int y = r.y0 + 1; y < r.y1; ++y)
+                    for (int x = r.x0 + 1; x < r.x1; ++x) add(x, y);
+            }
+            else {
+                const int xm = (r.x0 + r.x1) / 2, ym = (r.y0 + r.y1) / 2;
+                for (int y = r.y0 + 1; y < r.y1; ++y) add(xm, y);
+                for (int x = r.x0 + 1; x < r.x1; ++x)
+                    if (x != xm) add(x, ym);
+                next.push_back({r.x0, r.y0, xm, ym});
+                next.push_back({xm, r.y0, r.x1, ym});
+                next.push_back({r.x0, ym, xm, r.y1});
+                next.push_back({xm, ym, r.x1, r.y1});
+            }
+        }
+        sampler.compute(batch.data(), batch.size());
+        std::swap(current, next);
+    }
+}
+
+// Boundary tracing: the pixels of a region of equal count only need computing along the border of
+// the region, the inside is then filled. Starting from the border of the tile, every pixel that is
+// "scanned" gets its neighbours computed, and the neighbours whose count differs from it are
+// scanned in turn, so the tracing follows the edges between the bands of counts. The scans are
+// done a wave at a time, the pixels the wave needs going through the kernel in one batch. Each tile
+// is traced on its own, as if it were a whole image, so the tiles spread over the worker threads.
+static void boundary_trace(const Sampler& sampler, const Rectangle& tile) {
+    // The state of the pixels is kept per tile, at y * w + x in tile coordinates. The queues hold
+    // the coordinates packed as y << 16 | x, which spares a division for every pixel.
+    const int w = tile.x1 - tile.x0 + 1, h = tile.y1 - tile.y0 + 1, width = sampler.view.width;
+    int *const origin = &sampler.at(tile.x0, tile.y0);
+    enum : unsigned char { Computed = 1, Queued = 2 };
+    std::vector<unsigned char> state(w * h, 0);
+    std::vector<int> wave, next, batch;
+
+    auto queue = [&](int x, int y) {
+        unsigned char& s = state[y * w + x];
+        if (s & Queued) return;
+        s |= Queued;
+        next.push_back(y << 16 | x);
+    };
+    auto need = [&](int x, int y) {
+        unsigned char& s = state[y * w + x];
+        if (s & Computed) return;
+        s |= Computed;
+        batch.push_back((tile.y0 + y) * width + tile.x0 + x);
+    };
+
+    for (int x = 0; x < w; ++x) {
+        queue(x, 0);
+        queue(x, h - 1);
+    }
+    for (int y = 1; y < h - 1; ++y) {
+        queue(0, y);
+        queue(w - 1, y);
+    }
+
+    while (!next.empty()) {
+        std::swap(wave, next);
+        next.clear();
+
+        // The pixels of the wave and all their neighbours must be known
+        batch.clear();
+        for (int p : wave) {
+            const int x = p & 0xffff, y = p >> 16;
+            need(x, y);
+            if (x > 0) need(x - 1, y);
+            if (x < w - 1) need(x + 1, y);
+            if (y > 0) need(x, y - 1);
+            if (y < h - 1) need(x, y + 1);
+        }
+        sampler.compute(batch.data(), batch.size());
+
+        for (int p : wave) {
+            const int x = p & 0xffff, y = p >> 16;
+            const int *const count = origin + y * width + x;
+            const bool ll = x > 0, rr = x < w - 1, uu = y > 0, dd = y < h - 1;
+            const bool l = ll && count[-1] != *count;
+            const bool r = rr && count[1] != *count;
+            const bool u = uu && count[-width] != *count;
+            const bool d = dd && count[width] != *count;
+            if (l) queue(x - 1, y);
+            if (r) queue(x + 1, y);
+            if (u) queue(x, y - 1);
+            if (d) queue(x, y + 1);
+            // An edge may also go through a corner
+            if (uu && ll && (l || u)) queue(x - 1, y - 1);
+            if (uu && rr && (r || u)) queue(x + 1, y - 1);
+            if (dd && ll && (l || d)) queue(x - 1, y + 1);
+            if (dd && rr && (r || d)) queue(x + 1, y + 1);
+        }
+    }
+
+    // Every pixel left is inside a region closed by computed pixels of its count, and the first
+    // pixel of each row was computed: the rows are filled from left to right. So was the last one,
+    // which closes the runs of filled pixels for their fractions.
+    long filled = 0;
+    for (int y = 0; y < h; ++y) {
+        int *const row = origin + y * width;
+        const int start = (tile.y0 + y) * width + tile.x0;
+        int computed = 0; // The last pixel of the row computed
+        for (int x = 1; x < w; ++x) {
+            if (state[y * w + x] & Computed) {
+                if (sampler.smooth && x - computed > 1) interpolate_smooth(sampler.smooth, start + computed, start + x);
+                computed = x;
+                continue;
+            }
+            row[x] = row[x - 1];
+            ++filled;
+        }
+    }
+    sampler.stats.filled += filled;
+}
+
+// Solid guessing: the tile is first computed on a grid of block x block pixels, then the grid is
+// refined by halving its step. A pixel of the finer grid is guessed, given the count of the coarser
+// grid around it without being computed, when all the pixels of that grid around it have the same
+// count: the corners of its cell, or of the two cells it is the edge between. The last row and
+// column of the tile are taken as part of every grid, so the cells end on the border of the tile.
+// A guessed pixel gets the mean of the fractions of an iteration of those pixels.
+// With audit, one guessed pixel in audit is computed afterwards and its guess checked.
+static void solid_guess(const Sampler& sampler, const Rectangle& tile, int block, int audit) {
+    const int w = tile.x1 - tile.x0 + 1, h = tile.y1 - tile.y0 + 1, width = sampler.view.width;
+    const int origin = tile.y0 * width + tile.x0;
+    std::vector<unsigned char> guessed(w * h, 0); // At y * w + x in tile coordinates
+    std::vector<int> batch, values;
+    std::vector<int> guesses; // The pixels guessed by a level, then their values
+    std::vector<float> fractions; // The fractions of an iteration of the guesses
+
+    // The coordinates of a grid of the given step on a side of the tile, last is the last of them
+    auto on_grid = [](int c, int last, int step) { return c % step == 0 || c == last; };
+    auto next = [](int c, int last, int step) { return c == last ? last + 1 : std::min(c + step, last); };
+    // The coordinates of the grid of the given step around c: the one before, c itself when it is
+    // on the grid, and the one after
+    auto around = [&](int c, int last, int step, int *out) {
+        int n = 0;
+        if (c > 0) out[n++] = (c - 1) / step * step;
+        if (on_grid(c, last, step)) out[n++] = c;
+        if (c < last) out[n++] = std::min((c / step + 1) * step, last);
+        return n;
+    };
+
+    int step = 1;
+    while (step * 2 <= block) step *= 2;
+    for (int y = 0; y < h; y = next(y, h - 1, step))
+        for (int x = 0; x < w; x = next(x, w - 1, step)) batch.push_back(origin + y * width + x);
+    sampler.compute(batch.data(), batch.size());
+
+    long guess_count = 0;
+    for (step /= 2; step >= 1; step /= 2) {
+        batch.clear();
+        guesses.clear();
+        fractions.clear();
+        for (int y = 0; y < h; y = next(y, h - 1, step)) {
+            const bool known_row = on_grid(y, h - 1, 2 * step);
+            int ys[3];
+            const int ny = around(y, h - 1, 2 * step, ys);
+            for (int x = 0; x < w; x = next(x, w - 1, step)) {
+                if (known_row && on_grid(x, w - 1, 2 * step)) continue; // A pixel of the coarser grid
+                int xs[3];
+                const int nx = around(x, w - 1, 2 * step, xs);
+                const int value = sampler.counts[origin + ys[0] * width + xs[0]];
+                bool uniform = true;
+                for (int j = 0; j < ny && uniform; ++j)
+                    for (int i = 0; i < nx && uniform; ++i) uniform = sampler.counts[origin + ys[j] * width + xs[i]] == value;
+                if (uniform) {
+                    guesses.push_back(y * w + x);
+                    guesses.push_back(value);
+                    if (!sampler.smooth) continue;
+                    float sum = 0;
+                    for (int j = 0; j < ny; ++j)
+                        for (int i = 0; i < nx; ++i) sum += sampler.smooth[origin + ys[j] * width + xs[i]];
+                    fractions.push_back(sum / (nx * ny));
+                }
+                else batch.push_back(origin + y * width + x);
+            }
+        }
+        // The guesses only read the coarser grid, which the level does not change
+        sampler.compute(batch.data(), batch.size());
+        for (size_t k = 0; k < guesses.size(); k += 2) {
+            const int p = guesses[k];
+            sampler.counts[origin + p / w * width + p % w] = guesses[k + 1];
+            if (sampler.smooth) sampler.smooth[origin + p / w * width + p % w] = fractions[k / 2];
+            guessed[p] = 1;
+        }
+        guess_count += guesses.size() / 2;
+    }
+
+    long audited = 0, errors = 0;
+    if (audit > 0 && guess_count > 0) {
+        batch.clear();
+        values.clear();
+        long seen = 0;
+        for (int p = 0; p < w * h; ++p) {
+            if (!guessed[p] || seen++ % audit != 0) continue;
+            batch.push_back(origin + p / w * width + p % w);
+            values.push_back(sampler.counts[batch.back()]);
+        }
+        sampler.compute(batch.data(), batch.size());
+        audited = batch.size();
+        for (size_t k = 0; k < batch.size(); ++k) errors += sampler.counts[batch[k]] != values[k];
+    }
+    // The pixels audited are computed, and keep their counts
+    sampler.stats.filled += guess_count - audited;
+    if (audited) sampler.stats.audited += audited;
+    if (errors) sampler.stats.guess_errors += errors;
+}
+
+// The reflection of a view about an axis that goes through one of its rows or columns of pixels, or
+// between two: the pixels of its shorter side are those of the coordinates axis2 - c on the other.
+struct Mirror {
+    int axis2 = 0; // Twice the coordinate of the axis
+    int first = 0, last = -1; // The coordinates copied, none when last < first
+    int side = 0; // 1 when the coordinates kept are after the axis, -1 before, 0 without an axis
+
+    inline bool copied(int c) const { return c >= first && c <= last; }
+    // Takes the coordinates copied out of [c0, c1], which is left empty when it only has such coordinates.
+    inline void keep(int& c0, int& c1) const {
+        if (side > 0) c0 = std::max(c0, last + 1);
+        if (side < 0) c1 = std::min(c1, first - 1);
+    }
+    // Twice the distance of the coordinate c to the axis, and the coordinate kept at such a distance
+    inline int distance2(int c) const { return std::abs(2 * c - axis2); }
+    inline int kept_at(int d2) const { return (axis2 + side * d2) / 2; }
+};
+
+// The mirror about the axis where min + c * scale is 0, for the coordinates 0 ... size - 1.
+static Mirror find_mirror(double min, double scale, int size) {
+    Mirror mirror;
+    const double axis2 = -2 * min / scale;
+    if (!(axis2 >= 0 && axis2 <= 2 * (size - 1))) return mirror; // Also on the views too deep for doubles
+    mirror.axis2 = int(std::lround(axis2));
+    if (std::fabs(axis2 - mirror.axis2) > MIRROR_TOLERANCE) return mirror;
+    if (mirror.axis2 < size) { // The axis is on the first half
+        mirror.side = 1;
+        mirror.last = (mirror.axis2 + 1) / 2 - 1;
+    } else {
+        mirror.side = -1;
+        mirror.first = mirror.axis2 / 2 + 1;
+        mirror.last = size - 1;
+    }
+    return mirror;
+}
+
+// The symmetries of the set that map the pixels of a view on its pixels. The conjugate of a point has
+// the conjugate orbit, and the same count: the set is symmetric about the real axis, which crosses
+// the columns as the real part of c follows the rows. At the power p, it is also invariant by the
+// rotations of a (p - 1)th of a turn about the origin, but only two of them keep the pixels on the
+// pixels: with the conjugation, the half turn of the odd powers is the reflection about the imaginary
+// axis, and the quarter turn of the powers 1 + 4k the reflection about the diagonals through the
+// origin, when the pixels are square.
+struct Symmetry {
+    Mirror columns; // About the real axis
+    Mirror rows; // About the imaginary axis
+    // Within the rows and columns kept, the diagonal copies the pixels closer to the imaginary axis
+    // than to the real one from those the other way round, up to the last row kept.
+    bool diagonal = false;
+    int reach2 = 0; // Twice the distance of the last row kept to the imaginary axis
+
+    // The columns of the row y, one of those kept, whose pixels the diagonal copies: [c0, c1], empty
+    // when c0 > c1.
+    void diagonal_columns(int y, int width, int& c0, int& c1) const {
+        c0 = 0;
+        c1 = -1;
+        if (!diagonal) return;
+        // The distances doubled to the axes have the parity of the axes, the same for both
+        const int v = rows.distance2(y);
+        if (columns.side > 0) {
+            c0 = (columns.axis2 + v) / 2 + 1;
+            c1 = std::min((columns.axis2 + reach2) / 2, width - 1);
+        } else {
+            c0 = std::max((columns.axis2 - reach2) / 2, 0);
+            c1 = (columns.axis2 - v) / 2 - 1;
+        }
+    }
+    // Whether the diagonal copies all the pixels of [x0, x1] x [y0, y1], within the rows and columns kept
+    bool diagonal_covers(int x0, int y0, int x1, int y1) const {
+        if (!diagonal) return false;
+        const int u0 = columns.distance2(x0), u1 = columns.distance2(x1);
+        return std::max(rows.distance2(y0), rows.distance2(y1)) < std::min(u0, u1) && std::max(u0, u1) <= reach2;
+    }
+};
+
+// The symmetries of the sampler's view, or only those that map the pixels whose coordinates are
+// multiples of step on such pixels.
+static Symmetry find_symmetry(const Sampler& sampler, int step = 1) {
+    Symmetry symmetry;
+    const View& view = sampler.view;
+    const int power = sampler.params.power;
+    symmetry.columns = find_mirror(view.ymin, view.yscale(), view.width);
+    if (power >= 1 && power % 2 == 1) symmetry.rows = find_mirror(view.xmin, view.xscale(), view.height);
+    if (symmetry.columns.axis2 % step != 0) symmetry.columns = Mirror();
+    if (symmetry.rows.axis2 % step != 0) symmetry.rows = Mirror();
+    const Mirror& columns = symmetry.columns;
+    const Mirror& rows = symmetry.rows;
+    symmetry.diagonal = power % 4 == 1 && columns.side != 0 && rows.side != 0 &&
+                        (columns.axis2 - rows.axis2) % 2 == 0 && columns.axis2 % (2 * step) == 0 &&
+                        rows.axis2 % (2 * step) == 0 && std::fabs(view.xscale() / view.yscale() - 1) < SQUARE_TOLERANCE;
+    symmetry.reach2 = rows.side > 0 ? 2 * (view.height - 1) - rows.axis2 : rows.axis2;
+    return symmetry;
+}
+
+// Copies the pixels of the areas that the symmetry covers, or only those whose coordinates are
+// multiples of step, from their images. The images may be outside of the areas, known from before.
+// The diagonal goes first, as the mirrors then copy what it filled, and the rows before the columns,
+// which copy the pixels both mirrors cover from the rows.
+static void copy_symmetric(const Sampler& sampler, const Symmetry& symmetry, const std::vector<Rectangle>& areas, int step = 1) {
+    const int width = sampler.view.width;
+    FinalOrbits *const orbits = sampler.orbits;
+    float *const smooth = sampler.smooth;
+    const Mirror& columns = symmetry.columns;
+    const Mirror& rows = symmetry.rows;
+    auto up = [step](int c) { return (c + step - 1) / step * step; };
+
+    if (symmetry.diagonal) {
+        // The image of z by the reflection about the diagonal of the quadrant kept
+        const double sign = columns.side * rows.side;
+        for (const Rectangle& area : areas) {
+            int y0 = area.y0, y1 = area.y1;
+            rows.keep(y0, y1);
+            for (int y = up(y0); y <= y1; y += step) {
+                int x0, x1;
+                symmetry.diagonal_columns(y, width, x0, x1);
+                x0 = std::max(x0, area.x0);
+                x1 = std::min(x1, area.x1);
+                for (int x = up(x0); x <= x1; x += step) {
+                    const int n = y * width + x;
+                    const int from = rows.kept_at(columns.distance2(x)) * width + columns.kept_at(rows.distance2(y));
+                    sampler.counts[n] = sampler.counts[from];
+                    if (smooth) smooth[n] = smooth[from];
+                    if (!orbits) continue;
+                    orbits->re[n] = sign * orbits->im[from];
+                    orbits->im[n] = sign * orbits->re[from];
+                }
+            }
+        }
+    }
+    for (const Rectangle& area : areas) {
+        const int y0 = std::max(area.y0, rows.first), y1 = std::min(area.y1, rows.last);
+        for (int y = up(y0); y <= y1; y += step) {
+            for (int x = up(area.x0); x <= area.x1; x += step) {
+                const int n = y * width + x, from = (rows.axis2 - y) * width + x;
+                sampler.counts[n] = sampler.counts[from];
+                if (smooth) smooth[n] = smooth[from];
+                if (!orbits) continue;
+                orbits->re[n] = -orbits->re[from];
+                orbits->im[n] = orbits->im[from];
+            }
+        }
+    }
+    for (const Rectangle& area : areas) {
+        const int x0 = std::max(area.x0, columns.first), x1 = std::min(area.x1, columns.last);
+        for (int y = up(area.y0); y <= area.y1; y += step) {
+            for (int x = up(x0); x <= x1; x += step) {
+                const int n = y * width + x, from = n + columns.axis2 - 2 * x;
+                sampler.counts[n] = sampler.counts[from];
+                if (smooth) smooth[n] = smooth[from];
+                if (!orbits) continue;
+                orbits->re[n] = orbits->re[from];
+                orbits->im[n] = -orbits->im[from];
+            }
+        }
+    }
+}
+
+// Computes the n samples (x + m dx, y) of the row y that are in [lo, hi] but not in [c0, c1], and
+// returns how many.
+static int span_kept(const Sampler& sampler, int x, int dx, int n, int y, int lo, int hi, int c0, int c1) {
+    int computed = 0;
+    auto run = [&](int a, int b) {
+        const int first = a <= x ? 0 : (a - x + dx - 1) / dx, last = std::min(b < x ? -1 : (b - x) / dx, n - 1);
+        if (last < first) return;
+        sampler.span(x + first * dx, y, dx, 0, last - first + 1);
+        computed += last - first + 1;
+    };
+    if (c0 > c1) run(lo, hi);
+    else {
+        run(lo, std::min(hi, c0 - 1));
+        run(std::max(lo, c1 + 1), hi);
+    }
+    return computed;
+}
+
+// Fills the counts of the rectangles of the sampler's view with the given mode.
+static void render_areas(RenderMode mode, RenderPool& pool, const Sampler& sampler, const std::vector<Rectangle>& areas,
+                         const std::function<void(size_t, size_t)>& progress, const TileCallback& tile_done,
+                         const GuessSettings& guess) {
+    // The areas are cut into tiles that the worker threads compute in any order. The boundary
+    // tracing takes larger tiles, as the cost of a tile is mostly its border, and the solid guessing
+    // tiles of at least one block. Only the rows and columns the mirrors do not cover are computed,
+    // and the tiles the diagonal does not cover.
+    const Symmetry symmetry = find_symmetry(sampler);
+    const int tile_size = mode == RenderMode::BoundaryTrace ? BOUNDARY_TILE_SIZE
+                        : mode == RenderMode::SolidGuess ? std::max(TILE_SIZE, guess.block) : TILE_SIZE;
+    std::vector<Rectangle> tiles;
+    long mirrored = 0;
+    for (const Rectangle& area : areas) {
+        int x0 = area.x0, x1 = area.x1, y0 = area.y0, y1 = area.y1;
+        symmetry.columns.keep(x0, x1);
+        symmetry.rows.keep(y0, y1);
+        mirrored += long(area.x1 - area.x0 + 1) * (area.y1 - area.y0 + 1);
+        if (x0 > x1 || y0 > y1) continue;
+        mirrored -= long(x1 - x0 + 1) * (y1 - y0 + 1);
+        for (int y = y0; y <= y1; y += tile_size) {
+            for (int x = x0; x <= x1; x += tile_size) {
+                const Rectangle tile = {x, y, std::min(x + tile_size - 1, x1), std::min(y + tile_size - 1, y1)};
+                if (symmetry.diagonal_covers(tile.x0, tile.y0, tile.x1, tile.y1))
+                    mirrored += long(tile.x1 - tile.x0 + 1) * (tile.y1 - tile.y0 + 1);
+                else tiles.push_back(tile);
+            }
+        }
+    }
+    sampler.stats.mirrored += mirrored;
+    const size_t tile_count = tiles.size();
+
+    auto compute_tile = [&](size_t tile) {
+        const int x0 = tiles[tile].x0, y0 = tiles[tile].y0, x1 = tiles[tile].x1, y1 = tiles[tile].y1;
+
+        long computed = long(x1 - x0 + 1) * (y1 - y0 + 1);
+        switch (mode) {
+            case RenderMode::MarianiSilver:
+                mariani_silver(sampler, {x0, y0, x1, y1});
+                break;
+            case RenderMode::BoundaryTrace:
+                boundary_trace(sampler, {x0, y0, x1, y1});
+                break;
+            case RenderMode::SolidGuess:
+                solid_guess(sampler, {x0, y0, x1, y1}, guess.block, guess.audit);
+                break;
+            default:
+                // Without the pixels the diagonal copies
+                computed = 0;
+                for (int y = y0; y <= y1; ++y) {
+                    int c0, c1;
+                    symmetry.diagonal_columns(y, sampler.view.width, c0, c1);
+                    computed += span_kept(sampler, x0, 1, x1 - x0 + 1, y, x0, x1, c0, c1);
+                }
+                if (computed < long(x1 - x0 + 1) * (y1 - y0 + 1))
+                    sampler.stats.mirrored += long(x1 - x0 + 1) * (y1 - y0 + 1) - computed;
+                break;
+        }
+        sampler.stats.pixels += computed;
+        if (!tile_done) return;
+        tile_done(x0, y0, x1, y1);
+        // The images of the tile by the mirrors are known as well, and the tiles have different
+        // ones. Those of the diagonal may be computed by other tiles, they wait for the end.
+        const Mirror& columns = symmetry.columns;
+        const Mirror& rows = symmetry.rows;
+        const int mx0 = std::max(columns.axis2 - x1, columns.first), mx1 = std::min(columns.axis2 - x0, columns.last);
+        const int my0 = std::max(rows.axis2 - y1, rows.first), my1 = std::min(rows.axis2 - y0, rows.last);
+        std::vector<Rectangle> images;
+        if (my0 <= my1) images.push_back({x0, my0, x1, my1});
+        if (mx0 <= mx1) images.push_back({mx0, y0, mx1, y1});
+        if (mx0 <= mx1 && my0 <= my1) images.push_back({mx0, my0, mx1, my1});
+        if (images.empty()) return;
+        copy_symmetric(sampler, symmetry, images);
+        for (const Rectangle& image : images) tile_done(image.x0, image.y0, image.x1, image.y1);
+    };
+
+    pool.run(tile_count, compute_tile, [&](size_t done) { if (progress) progress(done, tile_count); });
+    if (sampler.perturbation) sampler.perturbation->fix_glitches(pool, sampler);
+    copy_symmetric(sampler, symmetry, areas); // Once the glitches are fixed
+}
+
+void render(RenderMode mode, RenderPool& pool, const Sampler& sampler,
+            const std::function<void(size_t, size_t)>& progress, const TileCallback& tile_done, const GuessSettings& guess) {
+    render_areas(mode, pool, sampler, {{0, 0, sampler.view.width - 1, sampler.view.height - 1}}, progress, tile_done, guess);
+}
+
+void render_pass(RenderPool& pool, const Sampler& sampler, int step, bool refine,
+                 const std::function<void(size_t, size_t)>& progress) {
+    const int width = sampler.view.width, height = sampler.view.height;
+
+    // The tiles grow with the step, so that they keep about the same number of samples. Their
+    // corners stay multiples of 2 * step.
+    const int tile_size = TILE_SIZE * step;
+    const int tiles_x = (width + tile_size - 1) / tile_size, tiles_y = (height + tile_size - 1) / tile_size;
+    const size_t tile_count = tiles_x * tiles_y;
+
+    // The image of a sample by a symmetry is one of the samples of the passes so far when its axis
+    // falls on one of their rows or columns, or between two
+    const Symmetry symmetry = find_symmetry(sampler, step);
+
+    auto compute_tile = [&](size_t tile) {
+        const int x0 = (tile % tiles_x) * tile_size, y0 = (tile / tiles_x) * tile_size;
+        const int x1 = std::min(x0 + tile_size, width) - 1, y1 = std::min(y0 + tile_size, height) - 1;
+        int kept0 = x0, kept1 = x1;
+        symmetry.columns.keep(kept0, kept1);
+
+        long samples = 0, mirrored = 0;
+        for (int y = y0; y <= y1; y += step) {
+            // On the rows of the previous pass, every other sample is known already
+            const bool known = refine && y % (2 * step) == 0;
+            const int x = known ? x0 + step : x0, dx = known ? 2 * step : step;
+            if (x > x1) continue;
+            const int n = (x1 - x) / dx + 1;
+            if (symmetry.rows.copied(y)) {
+                mirrored += n;
+                continue;
+            }
+            // The samples of the columns kept, but for those the diagonal copies
+            int c0, c1;
+            symmetry.diagonal_columns(y, width, c0, c1);
+            const int m = span_kept(sampler, x, dx, n, y, kept0, kept1, c0, c1);
+            samples += m;
+            mirrored += n - m;
+        }
+        sampler.stats.pixels += samples;
+        if (mirrored) sampler.stats.mirrored += mirrored;
+    };
+
+    pool.run(tile_count, compute_tile, [&](size_t done) { if (progress) progress(done, tile_count); });
+    if (sampler.perturbation) sampler.perturbation->fix_glitches(pool, sampler);
+    copy_symmetric(sampler, symmetry, {{0, 0, width - 1, height - 1}}, step);
+}
+
+void render_resume(RenderPool& pool, const Sampler& sampler, int previous_iterations,
+                   const std::function<void(size_t, size_t)>& progress) {
+    const int width = sampler.view.width, height = sampler.view.height;
+
+    // The pixels left are gathered over bands of rows, so that they fill the lanes of the kernel
+    // however scattered they are.
+    const size_t band_count = (height + TILE_SIZE - 1) / TILE_SIZE;
+    const Symmetry symmetry = find_symmetry(sampler);
+
+    auto compute_band = [&](size_t band) {
+        const int y0 = band * TILE_SIZE, y1 = std::min(y0 + TILE_SIZE, height);
+        std::vector<int> pixels;
+        long kept = 0, mirrored = 0;
+        for (int y = y0; y < y1; ++y) {
+            int c0, c1;
+            symmetry.diagonal_columns(y, width, c0, c1);
+            for (int x = 0; x < width; ++x) {
+                const bool copied = symmetry.rows.copied(y) || symmetry.columns.copied(x) || (x >= c0 && x <= c1);
+                if (!copied) ++kept;
+                if (sampler.at(x, y) < previous_iterations) continue;
+                if (!copied) pixels.push_back(y * width + x);
+                else ++mirrored;
+            }
+        }
+        sampler.compute(pixels.data(), pixels.size());
+        sampler.stats.pixels += kept;
+        sampler.stats.resumed += pixels.size();
+        if (mirrored) sampler.stats.mirrored += mirrored;
+    };
+
+    pool.run(band_count, compute_band, [&](size_t done) { if (progress) progress(done, band_count); });
+    // The images of a band may be in any other
+    copy_symmetric(sampler, symmetry, {{0, 0, width - 1, height - 1}});
+}
+
+// A number in [0, 1) given by the bits of seed, well mixed.
+static inline double jitter(uint32_t seed) {
+    seed ^= seed >> 16;
+    seed *= 0x7feb352d;
+    seed ^= seed >> 15;
+    seed *= 0x846ca68b;
+    seed ^= seed >> 16;
+    return seed / 4294967296.;
+}
+
+void render_subsamples(RenderPool& pool, const Sampler& sampler, long budget, Subsamples& subsamples,
+                       const std::function<void(size_t, size_t)>& progress) {
+    const int width = sampler.view.width, height = sampler.view.height;
+    const double xscale = sampler.view.xscale(), yscale = sampler.view.yscale();
+
+    // An edge is taken on its side of lower count, which is also the cheaper one: the pixels with a
+    // neighbour of higher count. The steps of the largest differences come first, until the
+    // iterations of their points, about those of the pixel and that neighbour, fill the budget.
+    struct Edge {
+        int pixel, step;
+        long cost;
+    };
+    const size_t band_count = (height + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<std::vector<Edge>> bands(band_count);
+    pool.run(band_count, [&](size_t band) {
+        for (int y = band * TILE_SIZE; y < std::min(int(band + 1) * TILE_SIZE, height); ++y) {
+            for (int x = 0; x < width; ++x) {
+                const int count = sampler.at(x, y);
+                int highest = count;
+                if (x > 0) highest = std::max(highest, sampler.at(x - 1, y));
+                if (x < width - 1) highest = std::max(highest, sampler.at(x + 1, y));
+                if (y > 0) highest = std::max(highest, sampler.at(x, y - 1));
+                if (y < height - 1) highest = std::max(highest, sampler.at(x, y + 1));
+                if (highest > count) bands[band].push_back({y * width + x, highest - count, SUBSAMPLES * (long(count) + highest) / 2});
+            }
+        }
+    });
+    std::vector<Edge> edges;
+    for (const std::vector<Edge>& band : bands) edges.insert(edges.end(), band.begin(), band.end());
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.step != b.step ? a.step > b.step : a.cost < b.cost;
+    });
+    subsamples.pixels.clear();
+    for (const Edge& edge : edges) {
+        if (edge.cost > budget) continue;
+        budget -= edge.cost;
+        subsamples.pixels.push_back(edge.pixel);
+    }
+    std::sort(subsamples.pixels.begin(), subsamples.pixels.end());
+
+    // The pixel's own point is at its centre. A point of each quarter is drawn from the index of the
+    // pixel, so that the image is the same every time but the points do not line up. The points of
+    // TILE_SIZE pixels go through the kernel together.
+    const size_t n = subsamples.pixels.size(), batch_count = (n + TILE_SIZE - 1) / TILE_SIZE;
+    subsamples.counts.resize(n * SUBSAMPLES);
+    subsamples.smooth.resize(sampler.smooth ? n * SUBSAMPLES : 0);
+    std::atomic<long> iterations{0};
+    auto compute_batch = [&](size_t batch) {
+        const size_t first = batch * TILE_SIZE, last = std::min(first + TILE_SIZE, n);
+        double re[TILE_SIZE * SUBSAMPLES], im[TILE_SIZE * SUBSAMPLES];
+        for (size_t k = first; k < last; ++k) {
+            const int pixel = subsamples.pixels[k], x = pixel % width, y = pixel / width;
+            for (int q = 0; q < SUBSAMPLES; ++q) {
+                const uint32_t seed = uint32_t(pixel) * SUBSAMPLES + q;
+                const double dx = 0.5 * (q % 2 + jitter(2 * seed)) - 0.5, dy = 0.5 * (q / 2 + jitter(2 * seed + 1)) - 0.5;
+                re[(k - first) * SUBSAMPLES + q] = sampler.view.re(y) + dy * xscale;
+                im[(k - first) * SUBSAMPLES + q] = sampler.view.im(x) + dx * yscale;
+            }
+        }
+        int *const found = &subsamples.counts[first * SUBSAMPLES];
+        sampler.sample(re, im, (last - first) * SUBSAMPLES, found,
+                       sampler.smooth ? &subsamples.smooth[first * SUBSAMPLES] : nullptr);
+        long sum = 0;
+        for (size_t m = 0; m < (last - first) * SUBSAMPLES; ++m) sum += found[m];
+        iterations += sum;
+    };
+
+    pool.run(batch_count, compute_batch, [&](size_t done) { if (progress) progress(done, batch_count); });
+    sampler.stats.supersampled += n;
+    sampler.stats.supersample_iterations += iterations;
+}
+
+void render_shifted(RenderMode mode, RenderPool& pool, const Sampler& sampler, int dx, int dy,
+                    const std::function<void(size_t, size_t)>& progress, const GuessSettings& guess) {
+    const int width = sampler.view.width, height = sampler.view.height;
+    shift_image(sampler.counts, width, height, dx, dy, 0);
+    if (sampler.smooth) shift_image(sampler.smooth, width, height, dx, dy, 0.f);
+    if (sampler.orbits) {
+        shift_image(sampler.orbits->re.data(), width, height, dx, dy, double(NAN));
+        shift_image(sampler.orbits->im.data(), width, height, dx, dy, double(NAN));
+    }
+    sampler.stats.moved = long(width - std::abs(dx)) * (height - std::abs(dy));
+
+    // The columns uncovered on one side, then the rows uncovered on the other, without the corner
+    // the columns already have
+    std::vector<Rectangle> strips;
+    if (dx > 0) strips.push_back({width - dx, 0, width - 1, height - 1});
+    if (dx < 0) strips.push_back({0, 0, -dx - 1, height - 1});
+    const int x0 = std::max(-dx, 0), x1 = width - 1 - std::max(dx, 0);
+    if (dy > 0) strips.push_back({x0, height - dy, x1, height - 1});
+    if (dy < 0) strips.push_back({x0, 0, x1, -dy - 1});
+    render_areas(mode, pool, sampler, strips, progress, nullptr, guess);
+}